@@ -1,9 +1,186 @@
 #include "big_integer.h"
+#include "decimal_kernels.h"
+#include "digit_kernels.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <system_error>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define BIGINT_LITTLE_ENDIAN
+#endif
+
+namespace {
+    // numbers of fewer digits are converted chunk by chunk, larger ones are split in halves
+    // by a power of the base
+    const std::size_t RADIX_SPLIT_THRESHOLD = 60;
+
+    // streams are read in blocks of width << READ_BLOCK_LEVEL characters of the chunk width
+    const std::size_t READ_BLOCK_LEVEL = 10;
+
+    const char RADIX_CHARS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+    // the largest power of a base that fits in a digit and its number of characters
+    struct radix_chunk {
+        digit_vector::digit_t power;
+        std::size_t width;
+    };
+
+    radix_chunk const &chunk_of(unsigned base) {
+        static const std::vector<radix_chunk> chunks = [] {
+            std::vector<radix_chunk> res(37, radix_chunk{1, 0});
+            for (unsigned b = 2; b <= 36; b++) {
+                res[b] = {b, 1};
+                while (res[b].power <= digit_vector::DIGIT_MASK / b) {
+                    res[b].power *= b;
+                    res[b].width++;
+                }
+            }
+            return res;
+        }();
+        return chunks[base];
+    }
+
+    // log2 of a power-of-two base, 0 for the other bases
+    unsigned bits_per_char(unsigned base) {
+        if ((base & (base - 1)) != 0) return 0;
+        unsigned bits = 0;
+        while ((1u << bits) != base) bits++;
+        return bits;
+    }
+
+    // the value of a digit in either case, 36 for the characters that are not digits in any base
+    unsigned char_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+        return 36;
+    }
+
+    unsigned stream_base(std::ios_base const &s) {
+        std::ios_base::fmtflags basefield = s.flags() & std::ios_base::basefield;
+        return (basefield == std::ios_base::hex ? 16 : basefield == std::ios_base::oct ? 8 : 10);
+    }
+
+    void check_base(int base) {
+        if (base < 2 || base > 36) throw std::invalid_argument("base must be between 2 and 36");
+    }
+
+    // writes the digits of value padded with zeros to width, returns the end of the output
+    char *write_chunk(digit_vector::digit_t value, unsigned base, std::size_t width, char *out) {
+        char buffer[std::numeric_limits<digit_vector::digit_t>::digits];
+        std::size_t size = 0;
+        if (base == 10) {
+            for (; value != 0; value /= 10) buffer[size++] = (char) ('0' + value % 10);
+        } else {
+            for (; value != 0; value /= base) buffer[size++] = RADIX_CHARS[value % base];
+        }
+        if (width > size) out = std::fill_n(out, width - size, '0');
+        while (size > 0) *out++ = buffer[--size];
+        return out;
+    }
+
+    // the number of characters write_chunk needs for value without padding
+    std::size_t chunk_length(digit_vector::digit_t value, unsigned base) {
+        std::size_t size = 0;
+        for (; value != 0; value /= base) size++;
+        return size;
+    }
+
+    // the position of the highest set bit plus one, for a value without leading zero digits
+    std::size_t significant_bits(digit_vector const &digits) {
+        std::size_t total = digits.size() * digit_vector::DIGIT_BASE;
+        for (digit_vector::digit_t top = digits.back(); (top >> (digit_vector::DIGIT_BASE - 1)) == 0; top <<= 1) {
+            total--;
+        }
+        return total;
+    }
+
+    const unsigned char BINARY_VERSION = 1;
+    const std::size_t BINARY_WORDS_PER_DIGIT = digit_vector::DIGIT_BASE / 32;
+
+    void write_binary_header(bool negative, std::size_t digits, unsigned char *out) {
+        std::size_t words = digits * BINARY_WORDS_PER_DIGIT;
+        if (words > 0xffffffffu) throw std::invalid_argument("value is too large for the binary format");
+        out[0] = BINARY_VERSION;
+        out[1] = (negative ? 1 : 0);
+        out[2] = out[3] = 0;
+        for (std::size_t i = 0; i < 4; i++) out[4 + i] = (unsigned char) (words >> (8 * i));
+    }
+
+    // the magnitude in the byte order of the format, with a single copy on little-endian hosts
+    void write_binary_digits(const digit_vector::digit_t *digits, std::size_t size, unsigned char *out) {
+#ifdef BIGINT_LITTLE_ENDIAN
+        if (size > 0) std::memcpy(out, digits, size * sizeof(digit_vector::digit_t));
+#else
+        for (std::size_t i = 0; i < size * sizeof(digit_vector::digit_t); i++) {
+            out[i] = (unsigned char) (digits[i / sizeof(digit_vector::digit_t)] >> (8 * (i % sizeof(digit_vector::digit_t))));
+        }
+#endif
+    }
+
+    // out must hold the words rounded up to whole digits, zeroed
+    void read_binary_digits(const unsigned char *data, std::size_t words, digit_vector::digit_t *out) {
+#ifdef BIGINT_LITTLE_ENDIAN
+        if (words > 0) std::memcpy(out, data, words * 4);
+#else
+        for (std::size_t i = 0; i < words * 4; i++) {
+            out[i / sizeof(digit_vector::digit_t)] |=
+                    (digit_vector::digit_t) data[i] << (8 * (i % sizeof(digit_vector::digit_t)));
+        }
+#endif
+    }
+
+    // whether the words at data can be used as digits in place
+    bool binary_digits_in_place(const unsigned char *data, std::size_t words) {
+#ifdef BIGINT_LITTLE_ENDIAN
+        return words % BINARY_WORDS_PER_DIGIT == 0 &&
+               reinterpret_cast<std::uintptr_t>(data) % alignof(digit_vector::digit_t) == 0;
+#else
+        (void) data;
+        (void) words;
+        return false;
+#endif
+    }
+
+    // zigzag codes below this take the short form of the compact format
+    const uint64_t COMPACT_SHORT_LIMIT = uint64_t(1) << 63;
+    // a varint never ends in a zero byte after the first one, so this starts the long form
+    const unsigned char COMPACT_LONG_MARKER[] = {0x80, 0x00};
+
+    std::size_t varint_size(uint64_t x) {
+        std::size_t size = 1;
+        for (; x >= 0x80; x >>= 7) size++;
+        return size;
+    }
+
+    unsigned char *write_varint(uint64_t x, unsigned char *out) {
+        for (; x >= 0x80; x >>= 7) *out++ = (unsigned char) (x | 0x80);
+        *out++ = (unsigned char) x;
+        return out;
+    }
+
+    // reads a varint of at most max_size bytes, rejecting bits beyond the 64 of the result
+    const unsigned char *read_varint(const unsigned char *first, const unsigned char *last, std::size_t max_size,
+                                     uint64_t &x) {
+        x = 0;
+        for (unsigned shift = 0; shift < 7 * max_size; shift += 7) {
+            if (first == last) throw std::invalid_argument("compact big_integer is truncated");
+            unsigned char byte = *first++;
+            if (shift == 63 && (byte & 0x7f) > 1) throw std::invalid_argument("compact big_integer is too large");
+            x |= (uint64_t) (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return first;
+        }
+        throw std::invalid_argument("not a big_integer in the compact format");
+    }
+}
 
 // MARK: Implementation details
 
@@ -32,19 +209,11 @@ void big_integer::clear() {
 }
 
 void big_integer::shift_left_by_words(std::size_t cnt) {
-    for (std::size_t step = 0; step < cnt; ++step) {
-        digits.insert(digits.begin(), 0);
-    }
+    if (!is_zero()) digits.prepend_zeros(cnt);
 }
 
 void big_integer::shift_right_by_words(std::size_t cnt) {
-    if (cnt >= digits.size()) {
-        digits.clear();
-    } else
-        for (size_t step = 0; step < cnt; ++step) {
-            digits.erase(digits.begin());
-        }
-
+    digits.drop_front(cnt);
     shrink();
 }
 
@@ -86,38 +255,54 @@ void big_integer::sub_unsigned_shifted_by_words(digit_vector::digit_t a, std::si
     shrink();
 }
 
-void big_integer::add_unsigned(big_integer other) {
-    for (std::size_t i = 0; i < other.digits.size(); i++) {
-        add_unsigned_shifted_by_words(other.digits[i], i);
-    }
+int big_integer::compare_unsigned(big_integer const &other) const {
+    return digit_kernels::cmp(digits.begin(), digits.size(), other.digits.begin(), other.digits.size());
 }
 
-void big_integer::sub_unsigned(big_integer other) {
-    for (std::size_t i = 0; i < other.digits.size(); i++) {
-        sub_unsigned_shifted_by_words(other.digits[i], i);
-    }
+void big_integer::add_unsigned(big_integer const &other) {
+    std::size_t size = std::max(digits.size(), other.digits.size());
+    std::size_t other_size = other.digits.size();
+    if (other_size == 0) return;
+
+    digits.resize(size + 1);
+    digit_vector::digit_t *res = digits.begin();
+    res[size] = digit_kernels::add(res, res, size, other.digits.begin(), other_size);
+    shrink();
+}
+
+void big_integer::sub_unsigned(big_integer const &other) {
+    // |*this| >= |other|
+    std::size_t size = digits.size();
+    digit_vector::digit_t *res = digits.begin();
+    if (digit_kernels::sub(res, res, size, other.digits.begin(), other.digits.size()) > 0)
+        throw std::runtime_error("carry is non-zero");
+    shrink();
+}
+
+void big_integer::rsub_unsigned(big_integer const &other) {
+    // |*this| <= |other|, *this = |other| - |*this|
+    std::size_t size = digits.size();
+    std::size_t other_size = other.digits.size();
+
+    digits.resize(other_size);
+    digit_vector::digit_t *res = digits.begin();
+    if (digit_kernels::sub(res, other.digits.begin(), other_size, res, size) > 0)
+        throw std::runtime_error("carry is non-zero");
+    shrink();
 }
 
 void big_integer::mul_unsigned(digit_vector::digit_t a) {
-    digit_vector::digit_t carry = 0;
-    for (digit_vector::digit_t &digit : digits) {
-        digit_vector::double_digit_t cur = (digit_vector::double_digit_t) digit * a + carry;
-        digit = (digit_vector::digit_t) (cur & digit_vector::DIGIT_MASK);
-        carry = (digit_vector::digit_t) (cur >> digit_vector::DIGIT_BASE);
-    }
+    std::size_t size = digits.size();
+    digit_vector::digit_t carry = digit_kernels::mul_1(digits.begin(), digits.begin(), size, a);
     if (carry > 0) digits.push_back(carry);
     shrink();
 }
 
 digit_vector::digit_t big_integer::div_mod_unsigned(digit_vector::digit_t a) {
-    digit_vector::digit_t carry = 0;
-    for (std::size_t tmp = 0, i = digits.size() - 1; tmp < digits.size(); tmp++, i--) {
-        digit_vector::double_digit_t cur = (((digit_vector::double_digit_t) carry) << digit_vector::DIGIT_BASE) + digits[i];
-        carry = (digit_vector::digit_t) (cur % a);
-        digits[i] = (digit_vector::digit_t) (cur / a);
-    }
+    std::size_t size = digits.size();
+    digit_vector::digit_t rem = digit_kernels::divrem_1(digits.begin(), digits.begin(), size, a);
     shrink();
-    return carry;
+    return rem;
 }
 
 void big_integer::bitwise_negate_digits() {
@@ -127,15 +312,6 @@ void big_integer::bitwise_negate_digits() {
     add_unsigned_shifted_by_words(1);
 }
 
-big_integer big_integer::slice_by_words(std::size_t from, std::size_t to) {
-    big_integer res = big_integer();
-//    res.digits = digit_vector(digits.begin() + from, digits.begin() + to);
-    for (std::size_t i = from; i < to; i++) {
-        res.digits.push_back(digits[i]);
-    }
-    return res;
-}
-
 void big_integer::to_complementary2() {
     if (negative) {
         negative = false;
@@ -171,22 +347,209 @@ big_integer::big_integer(int a) {
     shrink();
 }
 
-big_integer::big_integer(std::string const &str) {
-    bool neg = false;
-    for (std::size_t i = 0; i < str.length(); i++) {
-        char c = str[i];
+big_integer::big_integer(std::string const &str) : big_integer(from_string(str, 10)) {}
+
+// base^(width * 2^level) for the chunk width of the base, built by repeated squaring on first use
+// and shared by all threads
+big_integer const &big_integer::radix_power(unsigned base, std::size_t level) {
+    static std::mutex mutex;
+    static std::deque<big_integer> powers[37];
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::deque<big_integer> &cache = powers[base];
+    if (cache.empty()) cache.emplace_back(big_integer(chunk_of(base).power));
+    while (cache.size() <= level) cache.emplace_back(sqr(cache.back()));
+    return cache[level];
+}
+
+// radix_power prepared for division. Parsing only multiplies by the powers, so the reciprocals
+// are built here for just the levels that writing divides by
+invariant_divisor const &big_integer::radix_divisor(unsigned base, std::size_t level) {
+    static std::mutex mutex;
+    static std::deque<std::unique_ptr<const invariant_divisor>> divisors[37];
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::deque<std::unique_ptr<const invariant_divisor>> &cache = divisors[base];
+    if (cache.size() <= level) cache.resize(level + 1);
+    if (!cache[level]) cache[level].reset(new invariant_divisor(radix_power(base, level)));
+    return *cache[level];
+}
+
+// Writes the digits of a non-negative value padded with zeros to width and returns the end of
+// the output, or nullptr if they take more than space characters. The length is checked as soon
+// as the leading chunk is known, before anything is written. Large values are split by the largest
+// cached power of the base with at most half as many digits, which leaves the divisor between a
+// quarter and a half of the value's size. With fast division the conversion is O(M(n) log n)
+char *big_integer::write_radix(unsigned base, std::size_t width, char *out, std::size_t space) const {
+    radix_chunk const &chunk = chunk_of(base);
+    if (digits.size() < RADIX_SPLIT_THRESHOLD) {
+        // every chunk holds more than half a digit's worth of bits
+        digit_vector::digit_t chunks[2 * RADIX_SPLIT_THRESHOLD];
+        std::size_t count = 0;
+        big_integer x = *this;
+        while (!x.is_zero()) {
+            chunks[count++] = x.div_mod_unsigned(chunk.power);
+        }
+
+        if (count == 0) return (width > space ? nullptr : std::fill_n(out, width, '0'));
+        std::size_t rest = (count - 1) * chunk.width;
+        if (std::max(width, chunk_length(chunks[count - 1], base) + rest) > space) return nullptr;
+        out = write_chunk(chunks[count - 1], base, (width > rest ? width - rest : 0), out);
+        for (std::size_t i = count - 1; i > 0; i--) {
+            out = write_chunk(chunks[i - 1], base, chunk.width, out);
+        }
+        return out;
+    }
+
+    // the power at a level has at most 2^level digits, so the level follows from the size alone
+    // and no power is built beyond the one divided by
+    std::size_t level = 0;
+    while ((std::size_t(4) << level) <= digits.size() + 1) level++;
+
+    std::pair<big_integer, big_integer> qr = radix_divisor(base, level).divmod(*this);
+    std::size_t low_width = chunk.width << level;
+    if (width == 0 && qr.first.is_zero()) {
+        return qr.second.write_radix(base, 0, out, space);
+    }
+    if (space < low_width) return nullptr;
+    out = qr.first.write_radix(base, width > low_width ? width - low_width : 0, out, space - low_width);
+    if (out == nullptr) return nullptr;
+    return qr.second.write_radix(base, low_width, out, low_width);
+}
+
+// Power-of-two bases: every character is a group of bits read straight from the digits
+char *big_integer::write_bits(unsigned bits, char *out) const {
+    std::size_t size = digits.size(), total = significant_bits(digits);
+
+    const digit_vector::digit_t *d = digits.cbegin();
+    const digit_vector::digit_t mask = (digit_vector::digit_t(1) << bits) - 1;
+    std::size_t count = (total + bits - 1) / bits;
+    for (std::size_t i = 0; i < count; i++) {
+        std::size_t word = i * bits / digit_vector::DIGIT_BASE;
+        unsigned shift = i * bits % digit_vector::DIGIT_BASE;
+        digit_vector::digit_t value = d[word] >> shift;
+        if (shift + bits > digit_vector::DIGIT_BASE && word + 1 < size) {
+            value |= d[word + 1] << (digit_vector::DIGIT_BASE - shift);
+        }
+        out[count - 1 - i] = RADIX_CHARS[value & mask];
+    }
+    return out + count;
+}
+
+// Parses a string of digits. Short ones are consumed a digit's worth of characters at a time,
+// long ones are split into high * base^(width * 2^k) + low with the cached power
+big_integer big_integer::parse_radix(unsigned base, const char *first, const char *last) {
+    radix_chunk const &chunk = chunk_of(base);
+    std::size_t length = last - first;
+    if (length <= RADIX_SPLIT_THRESHOLD * chunk.width) {
+        big_integer res;
+        std::size_t width = (length % chunk.width == 0 ? chunk.width : length % chunk.width);
+        for (const char *p = first; p != last; p += width, width = chunk.width) {
+            digit_vector::digit_t scale = 1, value = 0;
+            for (std::size_t i = 0; i < width; i++) scale *= base;
+            if (base == 10) {
+                value = (digit_vector::digit_t) decimal_kernels::parse_chunk(p, width);
+            } else {
+                for (std::size_t i = 0; i < width; i++) value = value * base + char_value(p[i]);
+            }
+            res.mul_unsigned(scale);
+            res.add_unsigned_shifted_by_words(value);
+        }
+        res.shrink();
+        return res;
+    }
+
+    std::size_t level = 0;
+    while ((chunk.width << (level + 1)) < length) level++;
+    const char *middle = last - (chunk.width << level);
+    return parse_radix(base, first, middle) * radix_power(base, level) + parse_radix(base, middle, last);
+}
+
+// Power-of-two bases: the bits of the characters are packed into the digits from the end
+big_integer big_integer::parse_bits(unsigned bits, const char *first, const char *last) {
+    big_integer res;
+    res.digits.resize(((last - first) * bits + digit_vector::DIGIT_BASE - 1) / digit_vector::DIGIT_BASE);
+
+    digit_vector::digit_t *out = res.digits.begin(), acc = 0;
+    unsigned filled = 0;
+    for (const char *p = last; p != first;) {
+        auto value = (digit_vector::digit_t) char_value(*--p);
+        acc |= value << filled;
+        filled += bits;
+        if (filled >= digit_vector::DIGIT_BASE) {
+            *out++ = acc;
+            filled -= digit_vector::DIGIT_BASE;
+            acc = (filled > 0 ? value >> (bits - filled) : 0);
+        }
+    }
+    if (filled > 0) *out = acc;
+    res.shrink();
+    return res;
+}
+
+// base^exponent as a product of the cached powers
+big_integer big_integer::radix_power_of(unsigned base, std::size_t exponent) {
+    radix_chunk const &chunk = chunk_of(base);
+    digit_vector::digit_t low = 1;
+    for (std::size_t i = 0; i < exponent % chunk.width; i++) low *= base;
+
+    big_integer res(low);
+    std::size_t chunks = exponent / chunk.width;
+    for (std::size_t level = 0; (chunks >> level) != 0; level++) {
+        if ((chunks >> level) & 1) res *= radix_power(base, level);
+    }
+    return res;
+}
 
-        if (i == 0 && c == '-') {
-            neg = true;
-        } else if (!isdigit(c)) {
-            throw std::invalid_argument("non-digit character found in the string");
+// Reads the longest run of digits from buf and stores their number in count. Full blocks are
+// merged like a binary counter, two parts of the same length at a time, so only the value and
+// one block are kept in memory and the cost stays O(M(n) log n)
+big_integer big_integer::read_radix(unsigned base, std::streambuf *buf, std::size_t &count) {
+    unsigned bits = bits_per_char(base);
+    const std::size_t block_size = chunk_of(base).width << READ_BLOCK_LEVEL;
+    auto parse = [base, bits](const char *first, const char *last) {
+        return (bits != 0 ? parse_bits(bits, first, last) : parse_radix(base, first, last));
+    };
+    // high followed by the length digits of low
+    auto join = [base, bits](big_integer high, big_integer const &low, std::size_t length) {
+        if (high.is_zero()) return low;
+        if (bits != 0) {
+            // from 2^31 bits on the shift no longer fits in an int, so whole digits move separately
+            std::size_t shift = bits * length;
+            high.shift_left_by_words(shift / digit_vector::DIGIT_BASE);
+            high <<= (int) (shift % digit_vector::DIGIT_BASE);
         } else {
-            mul_unsigned(10);
-            add_unsigned_shifted_by_words((digit_vector::digit_t) (c - '0'));
+            high *= radix_power_of(base, length);
+        }
+        return high + low;
+    };
+
+    std::vector<char> block(block_size);
+    // parts of block_size << level characters, the levels strictly decreasing
+    std::vector<std::pair<big_integer, std::size_t>> parts;
+    std::size_t length = 0;
+    count = 0;
+    for (int c = buf->sgetc(); c != std::char_traits<char>::eof() && char_value((char) c) < base; c = buf->snextc()) {
+        block[length++] = (char) c;
+        if (length == block_size) {
+            big_integer part = parse(block.data(), block.data() + length);
+            std::size_t level = 0;
+            for (; !parts.empty() && parts.back().second == level; level++) {
+                part = join(parts.back().first, part, block_size << level);
+                parts.pop_back();
+            }
+            parts.emplace_back(part, level);
+            count += length;
+            length = 0;
         }
     }
-    shrink();
-    negative = neg;
+    count += length;
+
+    big_integer res;
+    for (std::pair<big_integer, std::size_t> const &part : parts) {
+        res = join(res, part.first, block_size << part.second);
+    }
+    return join(res, parse(block.data(), block.data() + length), length);
 }
 
 // MARK: Operations
@@ -210,135 +573,56 @@ big_integer &big_integer::operator+=(big_integer const &rhs) {
 
     if (lhs.negative == rhs.negative) {
         lhs.add_unsigned(rhs);
+    } else if (lhs.compare_unsigned(rhs) >= 0) {
+        // |a| >= |b|, the sign of a is kept
+        lhs.sub_unsigned(rhs);
     } else {
-        if (rhs.negative) {
-            // a > 0 && b < 0
-            lhs = lhs - rhs.absolute();
-        } else {
-            // a < 0 && b > 0
-            lhs = rhs - lhs.absolute();
-        }
+        // |a| < |b|, the sign of b is taken
+        lhs.rsub_unsigned(rhs);
+        lhs.negate();
     }
-
-    lhs.shrink();
     return lhs;
 }
 
 big_integer &big_integer::operator-=(big_integer const &rhs) {
     big_integer &lhs = *this;
 
-    if (lhs.negative == rhs.negative) {
-        if (lhs.absolute() >= rhs.absolute())
-            lhs.sub_unsigned(rhs);
-        else {
-            lhs = rhs - lhs;
-            lhs.negate();
-        }
+    if (lhs.negative != rhs.negative) {
+        lhs.add_unsigned(rhs);
+    } else if (lhs.compare_unsigned(rhs) >= 0) {
+        lhs.sub_unsigned(rhs);
     } else {
-        if (rhs.negative) {
-            // a > 0 && b < 0
-            lhs.add_unsigned(rhs);
-        } else {
-            // a < 0 && b > 0; -a + b
-            lhs.negate();
-            lhs.add_unsigned(rhs);
-        }
+        // a - b = -(b - a)
+        lhs.rsub_unsigned(rhs);
+        lhs.negate();
     }
-
-    lhs.shrink();
     return lhs;
 }
 
 big_integer &big_integer::operator*=(big_integer const &rhs) {
-    big_integer lhs_copy = *this;
     big_integer &lhs = *this;
-//    big_integer rhs = r;
-//    lhs.clear();
-//    lhs.digits.resize(lhs_copy.digits.size() + rhs.digits.size() + 1);
-//    std::fill(lhs.digits.begin(), lhs.digits.end(), 0);
-    std::size_t sz = lhs_copy.digits.size() + rhs.digits.size() + 1;
-    auto *digits = new digit_vector::digit_t[sz];
-    std::fill(digits, digits + sz, 0);
-
-    for (std::size_t i = 0; i < lhs_copy.digits.size(); i++) {
-        digit_vector::digit_t carry = 0;
-        for (std::size_t j = 0; j < rhs.digits.size() || carry > 0; j++) {
-            digit_vector::double_digit_t cur = (digit_vector::double_digit_t) digits[i + j] + carry +
-                                               (digit_vector::double_digit_t) lhs_copy.digits[i] * (j < rhs.digits.size() ? rhs.digits[j] : 0);
-            digits[i + j] = (digit_vector::digit_t) (cur & digit_vector::DIGIT_MASK);
-            carry = (digit_vector::digit_t) (cur >> digit_vector::DIGIT_BASE);
-        }
+    if (lhs.is_zero() || rhs.is_zero()) {
+        lhs.clear();
+        return lhs;
     }
 
-//    lhs.digits.clear();
-//    for (const auto &d : digits) lhs.digits.push_back(d);
-    lhs.digits = digit_vector(digits, sz);
+    // a *= a and operands sharing their storage reach the kernel as the same pointer and are squared
+    bool neg = lhs.negative != rhs.negative;
+    digit_vector res(lhs.digits.size() + rhs.digits.size());
+    digit_kernels::mul(res.begin(), lhs.digits.cbegin(), lhs.digits.size(), rhs.digits.cbegin(), rhs.digits.size());
 
-    if (rhs.negative) lhs.negate();
+    lhs.digits = res;
+    lhs.negative = neg;
     lhs.shrink();
     return lhs;
 }
 
-big_integer &big_integer::operator/=(big_integer const &rh) {
-    big_integer &lhs = *this;
-    big_integer rhs = rh;
-
-    if (lhs.is_zero()) return lhs = 0;
-    if (rhs.is_zero()) throw std::invalid_argument("divisor is zero");
-    if (lhs.negative != rhs.negative) return lhs = -(lhs.absolute() / rh.absolute());
-
-    lhs.negative = rhs.negative = false;
-
-    if (rhs.digits.size() == 1) {
-        lhs.div_mod_unsigned(rhs.digits[0]);
-        return lhs;
-    }
-    if (lhs < rhs) {
-        return lhs = 0;
-    }
-
-    // Source: https://members.loria.fr/PZimmermann/mca/mca-0.5.pdf
-
-    auto normalization = (digit_vector::digit_t) (((digit_vector::double_digit_t) digit_vector::DIGIT_MASK + 1) / ((digit_vector::double_digit_t) rhs.digits.back() + 1));
-    lhs *= normalization;
-    rhs *= normalization;
-
-    digit_vector new_digits(lhs.digits.size() - rhs.digits.size() + 1);
-
-    big_integer remainder = lhs.slice_by_words(lhs.digits.size() - rhs.digits.size() + 1, lhs.digits.size());
-    digit_vector::double_digit_t highest_digit = (rhs.is_zero() ? 0 : rhs.digits.back());
-
-    for (std::size_t tmp = 0, dig = new_digits.size() - 1; tmp < new_digits.size(); tmp++, dig--) {
-        remainder <<= digit_vector::DIGIT_BASE;
-        remainder += lhs.digits[dig];
-
-        digit_vector::double_digit_t rem_highest = (remainder.is_zero() ? 0 : remainder.digits.back());
-        if (remainder.digits.size() > rhs.digits.size()) {
-            rem_highest <<= digit_vector::DIGIT_BASE;
-            rem_highest += remainder.digits[remainder.digits.size() - 2];
-        }
-
-        digit_vector::double_digit_t quotient = rem_highest / highest_digit;
-        if (quotient >= digit_vector::DIGIT_MASK) quotient = digit_vector::DIGIT_MASK;
-
-        big_integer mul_dq = rhs * (digit_vector::digit_t) (quotient & digit_vector::DIGIT_MASK);
-        while (remainder < mul_dq) {
-            quotient--;
-            mul_dq -= rhs;
-        }
-
-        new_digits[dig] = (digit_vector::digit_t) (quotient & digit_vector::DIGIT_MASK);
-        remainder -= mul_dq;
-    }
-
-    lhs.digits = new_digits;
-    lhs.shrink();
-    return lhs;
+big_integer &big_integer::operator/=(big_integer const &rhs) {
+    return *this = divmod(*this, rhs).first;
 }
 
 big_integer &big_integer::operator%=(big_integer const &rhs) {
-    big_integer q = *this / rhs;
-    return *this -= rhs * q;
+    return *this = divmod(*this, rhs).second;
 }
 
 template<class Function>
@@ -377,30 +661,47 @@ big_integer &big_integer::operator^=(big_integer const &rhs) {
 }
 
 big_integer &big_integer::operator<<=(int rhs) {
-    if (rhs < 0) operator>>=(-rhs);
-
-    big_integer &lhs = *this;
-    lhs.shift_left_by_words(rhs / digit_vector::DIGIT_MASK);
-    auto bound = (rhs % digit_vector::DIGIT_MASK);
-    for (digit_vector::digit_t step = 0; step < bound; step++) {
-        lhs.mul_unsigned(2);
+    if (rhs < 0) return operator>>=(-rhs);
+    if (is_zero()) return *this;
+
+    std::size_t words = rhs / digit_vector::DIGIT_BASE;
+    unsigned bits = rhs % digit_vector::DIGIT_BASE;
+    shift_left_by_words(words);
+    if (bits > 0) {
+        // begin() may copy borrowed digits, so the pointer is taken once for both operands
+        digit_vector::digit_t *d = digits.begin() + words;
+        digit_vector::digit_t carry = digit_kernels::lshift(d, d, digits.size() - words, bits);
+        if (carry > 0) digits.push_back(carry);
     }
-    lhs.shrink();
-    return lhs;
+    return *this;
 }
 
 big_integer &big_integer::operator>>=(int rhs) {
-    if (rhs < 0) operator<<=(-rhs);
+    if (rhs < 0) return operator<<=(-rhs);
 
-    big_integer &lhs = *this;
-    lhs.shift_right_by_words(rhs / digit_vector::DIGIT_MASK);
-    auto bound = (rhs % digit_vector::DIGIT_MASK);
-    for (digit_vector::digit_t step = 0; step < bound; step++) {
-        lhs.div_mod_unsigned(2);
+    std::size_t words = rhs / digit_vector::DIGIT_BASE;
+    unsigned bits = rhs % digit_vector::DIGIT_BASE;
+
+    // negative values round towards minus infinity, so they grow by one in magnitude
+    // whenever a set bit is shifted out
+    bool neg = negative, inexact = false;
+    if (neg) {
+        std::size_t low = std::min(words, digits.size());
+        inexact = std::any_of(digits.cbegin(), digits.cbegin() + low, [](digit_vector::digit_t d) { return d != 0; });
+        if (bits > 0 && words < digits.size()) {
+            inexact = inexact || (digits.cbegin()[words] & ((digit_vector::digit_t(1) << bits) - 1)) != 0;
+        }
     }
-    if (lhs.negative) lhs--;
-    lhs.shrink();
-    return lhs;
+
+    shift_right_by_words(words);
+    if (bits > 0 && !digits.empty()) {
+        digit_vector::digit_t *d = digits.begin();
+        digit_kernels::rshift(d, d, digits.size(), bits);
+    }
+    negative = neg;
+    if (inexact) add_unsigned_shifted_by_words(1);
+    shrink();
+    return *this;
 }
 
 big_integer big_integer::operator+() const {
@@ -497,6 +798,71 @@ big_integer operator>>(big_integer a, int bits) {
     return res >>= bits;
 }
 
+big_integer sqr(big_integer const &a) {
+    big_integer res;
+    if (a.is_zero()) return res;
+
+    res.digits = digit_vector(2 * a.digits.size());
+    digit_kernels::sqr(res.digits.begin(), a.digits.cbegin(), a.digits.size());
+    res.shrink();
+    return res;
+}
+
+template<class Divide>
+std::pair<big_integer, big_integer> big_integer::divmod_digits(big_integer const &a, big_integer const &b, Divide divide) {
+    if (a.is_zero()) return std::make_pair(big_integer(), big_integer());
+    if (a.compare_unsigned(b) < 0) return std::make_pair(big_integer(), a);
+
+    std::size_t size = a.digits.size(), b_size = b.digits.size();
+    big_integer quotient, remainder;
+    quotient.digits = digit_vector(size - b_size + 1);
+    remainder.digits = digit_vector(b_size);
+    divide(quotient.digits.begin(), remainder.digits.begin(), a.digits.cbegin(), size);
+
+    quotient.negative = a.negative != b.negative;
+    remainder.negative = a.negative;
+    quotient.shrink();
+    remainder.shrink();
+    return std::make_pair(quotient, remainder);
+}
+
+std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b) {
+    if (b.is_zero()) throw std::invalid_argument("divisor is zero");
+    return big_integer::divmod_digits(a, b, [&b](digit_vector::digit_t *q, digit_vector::digit_t *r,
+                                                 const digit_vector::digit_t *a, std::size_t size) {
+        digit_kernels::divrem(q, r, a, size, b.digits.cbegin(), b.digits.size());
+    });
+}
+
+// MARK: Invariant divisor
+
+invariant_divisor::invariant_divisor(big_integer const &value) : divisor(value) {
+    if (divisor.is_zero()) throw std::invalid_argument("divisor is zero");
+    std::size_t size = divisor.digits.size();
+    prepared = std::make_shared<const digit_kernels::divisor>(
+            divisor.digits.cbegin(), size, size >= digit_kernels::invariant_newton_threshold);
+}
+
+big_integer const &invariant_divisor::value() const {
+    return divisor;
+}
+
+big_integer invariant_divisor::div(big_integer const &a) const {
+    return divmod(a).first;
+}
+
+big_integer invariant_divisor::mod(big_integer const &a) const {
+    return divmod(a).second;
+}
+
+std::pair<big_integer, big_integer> invariant_divisor::divmod(big_integer const &a) const {
+    const digit_kernels::divisor &d = *prepared;
+    return big_integer::divmod_digits(a, divisor, [&d](digit_vector::digit_t *q, digit_vector::digit_t *r,
+                                                      const digit_vector::digit_t *a, std::size_t size) {
+        digit_kernels::divrem(q, r, a, size, d);
+    });
+}
+
 // MARK: Comparisons
 
 bool operator==(big_integer const &a, big_integer const &b) {
@@ -538,23 +904,254 @@ bool operator>=(big_integer const &a, big_integer const &b) {
 }
 
 std::string to_string(big_integer const &a) {
-    if (a.is_zero()) return "0";
+    return to_string(a, 10);
+}
 
-    big_integer x = a;
-    bool neg = x.negative;
+std::string to_string(big_integer const &a, int base) {
+    check_base(base);
+    std::string res(to_chars_size(a, base), '\0');
+    res.resize(to_chars(&res[0], &res[0] + res.size(), a, base).ptr - res.data());
+    return res;
+}
 
-    std::string res;
-    while (!x.is_zero()) {
-        auto d = x.div_mod_unsigned(10);
-        res.insert(0, std::to_string(d));
-    }
-    if (neg) {
-        res.insert(0, "-");
+big_integer from_string(std::string const &str, int base) {
+    check_base(base);
+    const char *first = str.data() + (!str.empty() && str[0] == '-' ? 1 : 0), *last = str.data() + str.size();
+    bool valid = (base == 10 ? decimal_kernels::all_digits(first, last) :
+                  std::all_of(first, last, [base](char c) { return char_value(c) < (unsigned) base; }));
+    if (!valid) {
+        throw std::invalid_argument("non-digit character found in the string");
     }
 
+    unsigned bits = bits_per_char(base);
+    big_integer res = (bits != 0 ? big_integer::parse_bits(bits, first, last) :
+                       big_integer::parse_radix(base, first, last));
+    if (first != str.data()) res.negate();
     return res;
 }
 
+std::size_t to_chars_size(big_integer const &value, int base) {
+    check_base(base);
+    if (value.is_zero()) return 1;
+
+    std::size_t total = significant_bits(value.digits), sign = (value.negative ? 1 : 0);
+    unsigned bits = bits_per_char(base);
+    if (bits != 0) return (total + bits - 1) / bits + sign;
+
+    // a value below 2^total has at most floor(total * log_base(2)) + 1 digits, which is one more
+    // than needed when the value is close to 2^(total - 1). One more covers the rounding
+    return (std::size_t) ((double) total * std::log(2.0) / std::log((double) base)) + 2 + sign;
+}
+
+to_chars_result to_chars(char *first, char *last, big_integer const &value, int base) {
+    check_base(base);
+    std::size_t space = last - first, sign = (value.negative ? 1 : 0);
+    if (space == 0) return {last, std::errc::value_too_large};
+    if (value.is_zero()) {
+        *first = '0';
+        return {first + 1, std::errc()};
+    }
+
+    unsigned bits = bits_per_char(base);
+    if (bits != 0) {
+        if (space < to_chars_size(value, base)) return {last, std::errc::value_too_large};
+        if (value.negative) *first++ = '-';
+        return {value.write_bits(bits, first), std::errc()};
+    }
+
+    // a digit is at least a chunk, so every digit below the top one takes a full chunk width
+    if (space < sign + (value.digits.size() - 1) * chunk_of(base).width + 1) {
+        return {last, std::errc::value_too_large};
+    }
+    if (value.negative) *first++ = '-';
+    char *end = value.absolute().write_radix(base, 0, first, space - sign);
+    if (end == nullptr) return {last, std::errc::value_too_large};
+    return {end, std::errc()};
+}
+
+from_chars_result from_chars(const char *first, const char *last, big_integer &value, int base) {
+    check_base(base);
+    const char *begin = first + (first != last && *first == '-' ? 1 : 0), *end = begin;
+    while (end != last && char_value(*end) < (unsigned) base) end++;
+    if (end == begin) return {first, std::errc::invalid_argument};
+
+    unsigned bits = bits_per_char(base);
+    value = (bits != 0 ? big_integer::parse_bits(bits, begin, end) : big_integer::parse_radix(base, begin, end));
+    if (begin != first) value.negate();
+    return {end, std::errc()};
+}
+
 std::ostream &operator<<(std::ostream &s, big_integer const &a) {
-    return s << to_string(a);
+    return s << to_string(a, (int) stream_base(s));
+}
+
+std::istream &operator>>(std::istream &s, big_integer &a) {
+    std::istream::sentry sentry(s);
+    if (!sentry) return s;
+
+    std::streambuf *buf = s.rdbuf();
+    bool negative = (buf->sgetc() == '-');
+    if (negative) buf->sbumpc();
+
+    std::size_t count;
+    big_integer value = big_integer::read_radix(stream_base(s), buf, count);
+    std::ios_base::iostate state = std::ios_base::goodbit;
+    if (buf->sgetc() == std::char_traits<char>::eof()) state |= std::ios_base::eofbit;
+    if (count == 0) {
+        state |= std::ios_base::failbit;
+    } else {
+        if (negative) value.negate();
+        a = value;
+    }
+    s.setstate(state);
+    return s;
+}
+
+// MARK: Binary format
+
+std::size_t binary_size(big_integer const &value) {
+    return BINARY_HEADER_SIZE + value.digits.size() * sizeof(digit_vector::digit_t);
+}
+
+unsigned char *to_binary(big_integer const &value, unsigned char *out) {
+    std::size_t size = value.digits.size();
+    write_binary_header(value.negative, size, out);
+    write_binary_digits(value.digits.cbegin(), size, out + BINARY_HEADER_SIZE);
+    return out + BINARY_HEADER_SIZE + size * sizeof(digit_vector::digit_t);
+}
+
+const unsigned char *from_binary(const unsigned char *first, const unsigned char *last, big_integer &value) {
+    return from_binary(first, last, value, nullptr);
+}
+
+const unsigned char *from_binary(const unsigned char *first, const unsigned char *last, big_integer &value,
+                                 std::shared_ptr<const unsigned char> const &storage) {
+    if ((std::size_t) (last - first) < BINARY_HEADER_SIZE || first[0] != BINARY_VERSION || first[1] > 1 ||
+        first[2] != 0 || first[3] != 0) {
+        throw std::invalid_argument("not a big_integer in the binary format");
+    }
+    std::size_t words = 0;
+    for (std::size_t i = 0; i < 4; i++) words |= (std::size_t) first[4 + i] << (8 * i);
+    const unsigned char *data = first + BINARY_HEADER_SIZE;
+    if ((std::size_t) (last - data) / 4 < words) {
+        throw std::invalid_argument("binary big_integer is truncated");
+    }
+
+    big_integer res;
+    if (storage && binary_digits_in_place(data, words)) {
+        auto digits = reinterpret_cast<const digit_vector::digit_t *>(data);
+        res.digits = digit_vector(std::shared_ptr<const digit_vector::digit_t>(storage, digits),
+                                  words / BINARY_WORDS_PER_DIGIT);
+    } else {
+        res.digits.resize((words + BINARY_WORDS_PER_DIGIT - 1) / BINARY_WORDS_PER_DIGIT);
+        read_binary_digits(data, words, res.digits.begin());
+    }
+    res.negative = (first[1] == 1);
+    res.shrink();
+    value = res;
+    return data + words * 4;
+}
+
+binary_view::binary_view(big_integer const &value) : source(value) {
+    write_binary_header(source.negative, source.digits.size(), header_bytes);
+#ifndef BIGINT_LITTLE_ENDIAN
+    reordered.resize(limbs_size());
+    write_binary_digits(source.digits.cbegin(), source.digits.size(), reordered.data());
+#endif
+}
+
+const unsigned char *binary_view::header() const {
+    return header_bytes;
+}
+
+const unsigned char *binary_view::limbs() const {
+#ifdef BIGINT_LITTLE_ENDIAN
+    return reinterpret_cast<const unsigned char *>(source.digits.cbegin());
+#else
+    return reordered.data();
+#endif
+}
+
+std::size_t binary_view::limbs_size() const {
+    return source.digits.size() * sizeof(digit_vector::digit_t);
+}
+
+// MARK: Compact format
+
+bool big_integer::compact_code(uint64_t &code) const {
+    if (digits.size() * digit_vector::DIGIT_BASE > 64) return false;
+
+    uint64_t magnitude = 0;
+    for (std::size_t i = 0; i < digits.size(); i++) magnitude |= (uint64_t) digits[i] << (i * digit_vector::DIGIT_BASE);
+    if (magnitude > (COMPACT_SHORT_LIMIT >> 1) - (negative ? 0 : 1)) return false;
+    code = 2 * magnitude - (negative ? 1 : 0);
+    return true;
+}
+
+big_integer big_integer::from_compact_code(uint64_t code) {
+    big_integer res;
+    uint64_t magnitude = (code + 1) >> 1;
+    for (std::size_t i = 0; i * digit_vector::DIGIT_BASE < 64; i++) {
+        res.digits.push_back((digit_vector::digit_t) (magnitude >> (i * digit_vector::DIGIT_BASE)));
+    }
+    res.negative = (code & 1) != 0;
+    res.shrink();
+    return res;
+}
+
+std::size_t compact_size(big_integer const &value) {
+    uint64_t code;
+    if (value.compact_code(code)) return varint_size(code);
+
+    std::size_t words = value.digits.size() * BINARY_WORDS_PER_DIGIT;
+    return sizeof(COMPACT_LONG_MARKER) + varint_size(2 * words + 1) + 4 * words;
+}
+
+unsigned char *to_compact(big_integer const &value, unsigned char *out) {
+    uint64_t code;
+    if (value.compact_code(code)) return write_varint(code, out);
+
+    std::size_t size = value.digits.size(), words = size * BINARY_WORDS_PER_DIGIT;
+    out = std::copy(std::begin(COMPACT_LONG_MARKER), std::end(COMPACT_LONG_MARKER), out);
+    out = write_varint(2 * words + (value.negative ? 1 : 0), out);
+    write_binary_digits(value.digits.cbegin(), size, out);
+    return out + 4 * words;
+}
+
+const unsigned char *from_compact(const unsigned char *first, const unsigned char *last, big_integer &value) {
+    uint64_t code;
+    if (last - first < 2 || first[0] != COMPACT_LONG_MARKER[0] || first[1] != COMPACT_LONG_MARKER[1]) {
+        first = read_varint(first, last, 9, code);
+        value = big_integer::from_compact_code(code);
+        return first;
+    }
+
+    first = read_varint(first + sizeof(COMPACT_LONG_MARKER), last, 10, code);
+    uint64_t words = code >> 1;
+    if ((uint64_t) (last - first) / 4 < words) throw std::invalid_argument("compact big_integer is truncated");
+
+    big_integer res;
+    res.digits.resize((std::size_t) (words + BINARY_WORDS_PER_DIGIT - 1) / BINARY_WORDS_PER_DIGIT);
+    read_binary_digits(first, (std::size_t) words, res.digits.begin());
+    res.negative = (code & 1) != 0;
+    res.shrink();
+    value = res;
+    return first + 4 * words;
+}
+
+std::size_t compact_size(const big_integer *first, const big_integer *last) {
+    std::size_t size = 0;
+    for (; first != last; first++) size += compact_size(*first);
+    return size;
+}
+
+unsigned char *to_compact(const big_integer *first, const big_integer *last, unsigned char *out) {
+    for (; first != last; first++) out = to_compact(*first, out);
+    return out;
+}
+
+const unsigned char *from_compact(const unsigned char *first, const unsigned char *last, big_integer *values,
+                                  std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) first = from_compact(first, last, values[i]);
+    return first;
 }
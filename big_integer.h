@@ -5,9 +5,32 @@
 #include <cstdint>
 #include <iosfwd>
 #include <limits>
+#include <memory>
+#include <system_error>
+#include <utility>
 #include <vector>
 #include "digit_vector.h"
 
+namespace digit_kernels {
+    struct divisor;
+}
+
+struct invariant_divisor;
+
+struct binary_view;
+
+// results of to_chars and from_chars as in <charconv>: the end of the written or parsed
+// characters and an error code, which is zero on success
+struct to_chars_result {
+    char *ptr;
+    std::errc ec;
+};
+
+struct from_chars_result {
+    const char *ptr;
+    std::errc ec;
+};
+
 struct big_integer {
     big_integer();
 
@@ -29,7 +52,7 @@ struct big_integer {
 
     big_integer &operator*=(big_integer const &rhs);
 
-    big_integer &operator/=(big_integer const &r);
+    big_integer &operator/=(big_integer const &rhs);
 
     big_integer &operator%=(big_integer const &rhs);
 
@@ -71,6 +94,39 @@ struct big_integer {
 
     friend std::string to_string(big_integer const &a);
 
+    friend std::istream &operator>>(std::istream &s, big_integer &a);
+
+    friend std::string to_string(big_integer const &a, int base);
+
+    friend big_integer from_string(std::string const &str, int base);
+
+    friend std::size_t to_chars_size(big_integer const &value, int base);
+
+    friend to_chars_result to_chars(char *first, char *last, big_integer const &value, int base);
+
+    friend from_chars_result from_chars(const char *first, const char *last, big_integer &value, int base);
+
+    friend big_integer sqr(big_integer const &a);
+
+    friend std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b);
+
+    friend struct invariant_divisor;
+
+    friend struct binary_view;
+
+    friend std::size_t binary_size(big_integer const &value);
+
+    friend unsigned char *to_binary(big_integer const &value, unsigned char *out);
+
+    friend const unsigned char *from_binary(const unsigned char *first, const unsigned char *last, big_integer &value,
+                                            std::shared_ptr<const unsigned char> const &storage);
+
+    friend std::size_t compact_size(big_integer const &value);
+
+    friend unsigned char *to_compact(big_integer const &value, unsigned char *out);
+
+    friend const unsigned char *from_compact(const unsigned char *first, const unsigned char *last, big_integer &value);
+
 private:
     digit_vector digits;
     bool negative;
@@ -97,22 +153,88 @@ private:
 
     void sub_unsigned_shifted_by_words(digit_vector::digit_t a, std::size_t shift = 0);
 
-    void add_unsigned(big_integer other);
+    int compare_unsigned(big_integer const &other) const;
 
-    void sub_unsigned(big_integer other);
+    void add_unsigned(big_integer const &other);
+
+    void sub_unsigned(big_integer const &other);
+
+    void rsub_unsigned(big_integer const &other);
 
     void mul_unsigned(digit_vector::digit_t a);
 
     digit_vector::digit_t div_mod_unsigned(digit_vector::digit_t a);
 
-    big_integer slice_by_words(std::size_t from, std::size_t to);
-
     void to_complementary2();
 
     void from_complementary2();
 
     template<class Function>
     void apply_bitwise_operation(big_integer const &rhs, Function function);
+
+    char *write_radix(unsigned base, std::size_t width, char *out, std::size_t space) const;
+
+    char *write_bits(unsigned bits, char *out) const;
+
+    static big_integer const &radix_power(unsigned base, std::size_t level);
+
+    static invariant_divisor const &radix_divisor(unsigned base, std::size_t level);
+
+    static big_integer parse_radix(unsigned base, const char *first, const char *last);
+
+    static big_integer parse_bits(unsigned bits, const char *first, const char *last);
+
+    static big_integer radix_power_of(unsigned base, std::size_t exponent);
+
+    static big_integer read_radix(unsigned base, std::streambuf *buf, std::size_t &count);
+
+    bool compact_code(uint64_t &code) const;
+
+    static big_integer from_compact_code(uint64_t code);
+
+    template<class Divide>
+    static std::pair<big_integer, big_integer> divmod_digits(big_integer const &a, big_integer const &b, Divide divide);
+};
+
+// A divisor prepared once for dividing many numbers by the same value: the divisor is normalized
+// up front and large ones also get the reciprocal for Newton division. Rounds like divmod
+struct invariant_divisor {
+    explicit invariant_divisor(big_integer const &value);
+
+    big_integer const &value() const;
+
+    big_integer div(big_integer const &a) const;
+
+    big_integer mod(big_integer const &a) const;
+
+    std::pair<big_integer, big_integer> divmod(big_integer const &a) const;
+
+private:
+    big_integer divisor;
+    std::shared_ptr<const digit_kernels::divisor> prepared;
+};
+
+// The binary format, version 1: a header of the version byte, a sign byte (1 for negative), two
+// zero bytes and the number of 32-bit words as a little-endian uint32, followed by the magnitude
+// in that many little-endian words, lowest first. The top words may be zero
+const std::size_t BINARY_HEADER_SIZE = 8;
+
+// A value in the binary format as the header and the magnitude. On little-endian hosts the
+// magnitude is the value's own digit storage, shared rather than copied
+struct binary_view {
+    explicit binary_view(big_integer const &value);
+
+    // BINARY_HEADER_SIZE bytes
+    const unsigned char *header() const;
+
+    const unsigned char *limbs() const;
+
+    std::size_t limbs_size() const;
+
+private:
+    big_integer source;
+    unsigned char header_bytes[BINARY_HEADER_SIZE];
+    std::vector<unsigned char> reordered;
 };
 
 big_integer operator+(big_integer a, big_integer const &b);
@@ -135,6 +257,70 @@ big_integer operator<<(big_integer a, int bits);
 
 big_integer operator>>(big_integer a, int bits);
 
+big_integer sqr(big_integer const &a);
+
+// quotient rounded towards zero and the remainder with the sign of a
+std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b);
+
+// Digits in bases 2 to 36 with an optional minus sign. Letters are written in lowercase and read
+// in either case; power-of-two bases are converted in linear time
+std::string to_string(big_integer const &a, int base);
+
+big_integer from_string(std::string const &str, int base);
+
+// An upper bound on the characters to_chars writes: exact for power-of-two bases, at most two
+// more than needed for the others
+std::size_t to_chars_size(big_integer const &value, int base = 10);
+
+// Writes the digits straight into [first, last), without an intermediate string. If they do not
+// fit, returns last and std::errc::value_too_large
+to_chars_result to_chars(char *first, char *last, big_integer const &value, int base = 10);
+
+// Parses the longest prefix of digits with an optional minus sign. If there are no digits,
+// returns first and std::errc::invalid_argument and leaves value unchanged
+from_chars_result from_chars(const char *first, const char *last, big_integer &value, int base = 10);
+
+// The stream's basefield picks the base: std::hex for 16, std::oct for 8 and decimal otherwise
 std::ostream &operator<<(std::ostream &s, big_integer const &a);
 
+// Reads an optional minus sign and the longest run of digits after it straight from the stream
+// buffer, without collecting the text first. Sets failbit and leaves a unchanged if there are
+// no digits; as with the built-in integer types, a minus sign read before that stays consumed
+std::istream &operator>>(std::istream &s, big_integer &a);
+
+// the number of bytes to_binary writes
+std::size_t binary_size(big_integer const &value);
+
+// Writes the value in the binary format and returns the end of the output
+unsigned char *to_binary(big_integer const &value, unsigned char *out);
+
+// Reads one value in the binary format from the start of [first, last) and returns its end.
+// Throws std::invalid_argument on an unknown version or a truncated value
+const unsigned char *from_binary(const unsigned char *first, const unsigned char *last, big_integer &value);
+
+// The same, but when the digits are aligned and laid out as in memory, the value borrows them
+// from storage, which owns [first, last), instead of copying. They are copied on the first change
+const unsigned char *from_binary(const unsigned char *first, const unsigned char *last, big_integer &value,
+                                 std::shared_ptr<const unsigned char> const &storage);
+
+// The compact format for mostly small values. A value v has the zigzag code 2|v| for v >= 0 and
+// 2|v| - 1 otherwise. Codes below 2^63 are written as a varint of 1 to 9 bytes, 7 bits per byte
+// from the lowest with the top bit set on all but the last. Larger values are the bytes 0x80 0x00,
+// a varint of twice the number of 32-bit words plus the sign bit, and the words as in the binary
+// format
+std::size_t compact_size(big_integer const &value);
+
+unsigned char *to_compact(big_integer const &value, unsigned char *out);
+
+// Reads one value and returns its end. Throws std::invalid_argument on malformed or truncated input
+const unsigned char *from_compact(const unsigned char *first, const unsigned char *last, big_integer &value);
+
+// the same for arrays of values, stored back to back
+std::size_t compact_size(const big_integer *first, const big_integer *last);
+
+unsigned char *to_compact(const big_integer *first, const big_integer *last, unsigned char *out);
+
+const unsigned char *from_compact(const unsigned char *first, const unsigned char *last, big_integer *values,
+                                  std::size_t count);
+
 #endif // BIG_INTEGER_H
@@ -1,11 +1,19 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
 #include <vector>
 #include <utility>
 #include "gtest/gtest.h"
 
 #include "big_integer.h"
+#include "digit_kernels.h"
+#include "mapped_file.h"
 
 TEST(correctness, two_plus_two)
 {
@@ -489,6 +497,25 @@ TEST(correctness, add_long_pow2)
     EXPECT_EQ(c + b, a);
 }
 
+TEST(correctness, add_sub_carry_propagation)
+{
+    big_integer a("115792089237316195423570985008687907853269984665640564039457584007913129639935");
+    big_integer b("115792089237316195423570985008687907853269984665640564039457584007913129639936");
+
+    EXPECT_EQ(a + 1, b);
+    EXPECT_EQ(b - 1, a);
+    EXPECT_EQ(1 - b, -a);
+    EXPECT_EQ(-b + a, -1);
+    EXPECT_EQ(a + -b, -1);
+    EXPECT_EQ(a - b, -1);
+
+    big_integer c = a;
+    c += c;
+    EXPECT_EQ(c, a * 2);
+    c -= c;
+    EXPECT_EQ(c, 0);
+}
+
 TEST(correctness, sub_long)
 {
     big_integer a("10000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000");
@@ -537,6 +564,34 @@ TEST(correctness, mul_long_pow2)
     EXPECT_EQ(b * b, c);
 }
 
+TEST(correctness, mul_div_digit_boundaries)
+{
+    big_integer a("18446744073709551615");
+    big_integer b("340282366920938463426481119284349108225");
+    big_integer c("79228162532711081662958534655");
+    big_integer d("79228162514264337593543962681"); // 2^96 + 12345
+
+    EXPECT_EQ(a * a, b);
+    EXPECT_EQ(b / a, a);
+    EXPECT_EQ(b / big_integer("4294967295"), c);
+    EXPECT_EQ(d / a, big_integer("4294967296"));
+    EXPECT_EQ(d % a, big_integer("4294979641"));
+}
+
+TEST(correctness, sqr_)
+{
+    big_integer a("-18446744073709551616");
+    big_integer b("340282366920938463463374607431768211456");
+
+    EXPECT_EQ(sqr(a), b);
+    EXPECT_EQ(sqr(0), 0);
+    EXPECT_EQ(sqr(-3), 9);
+
+    big_integer c = a;
+    c *= c;
+    EXPECT_EQ(c, b);
+}
+
 TEST(correctness, div_long)
 {
     big_integer a("10000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000");
@@ -564,6 +619,46 @@ TEST(correctness, div_long_signed2)
     EXPECT_EQ(a / b, c);
 }
 
+TEST(correctness, divmod_)
+{
+    big_integer a("-10000000000000000000000000000000000000000000000000000000000000000000000000000000000000000007");
+    big_integer b(                                                     "100000000000000000000000000000000000000");
+
+    std::pair<big_integer, big_integer> qr = divmod(a, b);
+    EXPECT_EQ(qr.first * b + qr.second, a);
+    EXPECT_EQ(qr.second, -7);
+    for (big_integer const &x : {a, -a, a + 3, b * 3, -b - 1})
+    {
+        for (big_integer const &y : {b, -b, big_integer(3), big_integer(-3)})
+        {
+            std::pair<big_integer, big_integer> res = divmod(x, y);
+            EXPECT_EQ(res.first * y + res.second, x);
+            EXPECT_TRUE(res.second == 0 || (res.second < 0) == (x < 0));
+            EXPECT_LT(res.second.absolute(), y.absolute());
+        }
+    }
+    EXPECT_EQ(divmod(7, -2).first, -3);
+    EXPECT_EQ(divmod(7, -2).second, 1);
+    EXPECT_EQ(divmod(b, a).second, b);
+    EXPECT_THROW(divmod(a, 0), std::invalid_argument);
+}
+
+TEST(correctness, invariant_divisor_)
+{
+    big_integer b("-100000000000000000000000000000000000000");
+    invariant_divisor d(b);
+    std::vector<big_integer> values = {0, 7, -7, b, -b, b * b + 12345, big_integer("-10000000000000000000000000000000000000000000000000000000000000000000000000000000000000000007")};
+    for (big_integer const &a : values)
+    {
+        EXPECT_EQ(d.div(a), a / b);
+        EXPECT_EQ(d.mod(a), a % b);
+        EXPECT_EQ(d.divmod(a), divmod(a, b));
+    }
+    EXPECT_EQ(d.value(), b);
+    EXPECT_EQ(invariant_divisor(-2).divmod(7), divmod(7, -2));
+    EXPECT_THROW(invariant_divisor(0), std::invalid_argument);
+}
+
 TEST(correctness, negation_long)
 {
     big_integer a( "10000000000000000000000000000000000000000000000000000");
@@ -607,6 +702,17 @@ TEST(correctness, string_conv)
     EXPECT_EQ(to_string(big_integer("-1000000000000000")), "-1000000000000000");
 }
 
+TEST(correctness, string_parse_long)
+{
+    EXPECT_EQ(to_string(big_integer("-" + std::string(3000, '0') + "12")), "-12");
+    EXPECT_EQ(big_integer(std::string(4000, '0')), 0);
+    EXPECT_EQ(big_integer("1" + std::string(3000, '0')), big_integer("1" + std::string(1500, '0')) *
+                                                         big_integer("1" + std::string(1500, '0')));
+    EXPECT_THROW(big_integer("12a3"), std::invalid_argument);
+    EXPECT_THROW(big_integer("1-2"), std::invalid_argument);
+    EXPECT_THROW(big_integer(std::string(3000, '1') + "+"), std::invalid_argument);
+}
+
 
 namespace
 {
@@ -734,4 +840,861 @@ TEST(correctness, div_randomized)
         EXPECT_GE(residue, 0);
         EXPECT_LT(residue, divisor);
     }
-}
\ No newline at end of file
+}
+
+namespace
+{
+    template <typename Function>
+    void with_threshold(std::size_t &threshold, std::size_t value, Function function)
+    {
+        std::size_t backup = threshold;
+        threshold = value;
+        function();
+        threshold = backup;
+    }
+}
+
+TEST(correctness, mul_karatsuba_randomized)
+{
+    for (size_t itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        big_integer a = rand_big(40 + rand() % 200);
+        big_integer b = (itn % 2 == 0 ? rand_big(40 + rand() % 200) : -a);
+
+        big_integer expected;
+        with_threshold(digit_kernels::karatsuba_threshold, std::numeric_limits<std::size_t>::max(), [&] {
+            expected = a * b;
+        });
+        with_threshold(digit_kernels::karatsuba_threshold, 4, [&] {
+            EXPECT_EQ(a * b, expected);
+        });
+    }
+}
+
+TEST(correctness, mul_toom_randomized)
+{
+    for (size_t itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        big_integer a = rand_big(100 + rand() % 600);
+        big_integer b = (itn % 3 == 0 ? a : rand_big(100 + rand() % 600));
+
+        big_integer expected;
+        with_threshold(digit_kernels::karatsuba_threshold, std::numeric_limits<std::size_t>::max(), [&] {
+            expected = a * b;
+        });
+        std::size_t toom4 = (itn % 2 == 0 ? std::numeric_limits<std::size_t>::max() : 16 + itn % 32);
+        with_threshold(digit_kernels::karatsuba_threshold, 4, [&] {
+            with_threshold(digit_kernels::toom3_threshold, 12, [&] {
+                with_threshold(digit_kernels::toom4_threshold, toom4, [&] {
+                    EXPECT_EQ(a * b, expected);
+                });
+            });
+        });
+    }
+}
+
+TEST(correctness, mul_ntt_randomized)
+{
+    big_integer all_ones = (big_integer(1) << 5000) - 1;
+
+    for (size_t itn = 0; itn != number_of_iterations * 2; ++itn)
+    {
+        big_integer a = (itn == 0 ? all_ones : rand_big(10 + rand() % 300));
+        big_integer b = (itn % 3 == 0 ? -a : rand_big(10 + rand() % 600));
+
+        big_integer expected;
+        with_threshold(digit_kernels::ntt_threshold, std::numeric_limits<std::size_t>::max(), [&] {
+            expected = a * b;
+        });
+        with_threshold(digit_kernels::ntt_threshold, 2, [&] {
+            EXPECT_EQ(a * b, expected);
+        });
+    }
+}
+
+TEST(correctness, sqr_randomized)
+{
+    for (size_t itn = 0; itn != number_of_iterations * 4; ++itn)
+    {
+        big_integer a = rand_big(1 + rand() % 800);
+        big_integer b = a + 1;
+
+        big_integer expected = a * b - a;
+        EXPECT_EQ(sqr(a), expected);
+        with_threshold(digit_kernels::karatsuba_threshold, 4, [&] {
+            with_threshold(digit_kernels::toom3_threshold, 12, [&] {
+                with_threshold(digit_kernels::toom4_threshold, itn % 2 == 0 ? 16 : 1000, [&] {
+                    EXPECT_EQ(sqr(a), expected);
+                    with_threshold(digit_kernels::ntt_threshold, 20, [&] {
+                        EXPECT_EQ(sqr(a), expected);
+                    });
+                });
+            });
+        });
+    }
+}
+
+TEST(correctness, mul_parallel_randomized)
+{
+    std::size_t threads = digit_kernels::thread_count();
+    digit_kernels::set_thread_count(4);
+
+    for (size_t itn = 0; itn != number_of_iterations; ++itn)
+    {
+        big_integer a = rand_big(100 + rand() % 2000);
+        big_integer b = (itn % 2 == 0 ? a : rand_big(100 + rand() % 2000));
+
+        big_integer expected;
+        with_threshold(digit_kernels::karatsuba_threshold, std::numeric_limits<std::size_t>::max(), [&] {
+            expected = a * b;
+        });
+        with_threshold(digit_kernels::toom3_threshold, 12, [&] {
+            with_threshold(digit_kernels::toom4_threshold, 40, [&] {
+                with_threshold(digit_kernels::parallel_threshold, 12, [&] {
+                    EXPECT_EQ(a * b, expected);
+                    with_threshold(digit_kernels::ntt_threshold, 30, [&] {
+                        EXPECT_EQ(a * b, expected);
+                    });
+                });
+            });
+        });
+    }
+
+    digit_kernels::set_thread_count(threads);
+}
+
+TEST(correctness, div_structured)
+{
+    // divisors and dividends made of long runs of ones and zeros hit the corrections
+    // of the quotient digit estimate
+    for (int x = 1; x <= 300; x += 7)
+    {
+        for (int y = 1; y <= x; y += 5)
+        {
+            big_integer ones_x = (big_integer(1) << x) - 1;
+            big_integer ones_y = (big_integer(1) << y) - 1;
+            std::vector<std::pair<big_integer, big_integer>> cases = {
+                    {ones_x, ones_y},
+                    {ones_x << x, ones_y},
+                    {(ones_x << (x + 3)) + ones_x, (ones_y << y) + 1},
+                    {big_integer(1) << (x + y), (big_integer(1) << y) + 1},
+                    {(ones_x << 64) - ones_y, (big_integer(1) << (y + 63)) - ones_y},
+            };
+            for (auto const &c : cases)
+            {
+                big_integer quotient = c.first / c.second;
+                big_integer residue = c.first % c.second;
+                ASSERT_EQ(quotient * c.second + residue, c.first);
+                ASSERT_GE(residue, 0);
+                ASSERT_LT(residue, c.second);
+            }
+        }
+    }
+}
+
+TEST(correctness, div_recursive_randomized)
+{
+    for (size_t itn = 0; itn != number_of_iterations * 5; ++itn)
+    {
+        big_integer b = rand_big(20 + rand() % 400);
+        big_integer a = (itn % 4 == 0 ? b * b - 1 : rand_big(20 + rand() % 1200));
+        if (itn % 2 == 1)
+        {
+            a = -a;
+        }
+
+        std::pair<big_integer, big_integer> expected;
+        with_threshold(digit_kernels::bz_threshold, std::numeric_limits<std::size_t>::max(), [&] {
+            expected = divmod(a, b);
+        });
+        with_threshold(digit_kernels::bz_threshold, 4 + itn % 8, [&] {
+            std::pair<big_integer, big_integer> actual = divmod(a, b);
+            EXPECT_EQ(actual.first, expected.first);
+            EXPECT_EQ(actual.second, expected.second);
+        });
+        EXPECT_EQ(expected.first * b + expected.second, a);
+    }
+}
+
+TEST(correctness, div_newton_randomized)
+{
+    for (size_t itn = 0; itn != number_of_iterations * 5; ++itn)
+    {
+        big_integer b = rand_big(20 + rand() % 400);
+        big_integer a = (itn % 4 == 0 ? b * b - 1 : rand_big(20 + rand() % 1200));
+        if (itn % 3 == 0)
+        {
+            b = (big_integer(1) << (64 * (10 + itn % 20) - 1)) + (int) (itn % 2);
+        }
+
+        std::pair<big_integer, big_integer> expected;
+        with_threshold(digit_kernels::bz_threshold, std::numeric_limits<std::size_t>::max(), [&] {
+            expected = divmod(a, b);
+        });
+        std::size_t ntt = (itn % 2 == 0 ? digit_kernels::ntt_threshold : 2);
+        with_threshold(digit_kernels::newton_threshold, 4 + itn % 8, [&] {
+            with_threshold(digit_kernels::ntt_threshold, ntt, [&] {
+                std::pair<big_integer, big_integer> actual = divmod(a, b);
+                EXPECT_EQ(actual.first, expected.first);
+                EXPECT_EQ(actual.second, expected.second);
+            });
+        });
+    }
+}
+
+TEST(correctness, invariant_divisor_randomized)
+{
+    for (size_t itn = 0; itn != number_of_iterations; ++itn)
+    {
+        big_integer b = rand_big(1 + rand() % 100);
+        std::size_t threshold = (itn % 2 == 0 ? digit_kernels::invariant_newton_threshold : 1);
+        with_threshold(digit_kernels::invariant_newton_threshold, threshold, [&] {
+            invariant_divisor d(b);
+            for (size_t i = 0; i != 10; ++i)
+            {
+                big_integer a = rand_big(rand() % 300);
+                if (i % 2 == 1)
+                {
+                    a = -a;
+                }
+                EXPECT_EQ(d.divmod(a), divmod(a, b));
+            }
+        });
+    }
+}
+
+TEST(correctness, div_single_digit_randomized)
+{
+    big_integer base = big_integer(1) << digit_vector::DIGIT_BASE;
+    for (size_t itn = 0; itn != number_of_iterations * 5; ++itn)
+    {
+        big_integer a = rand_big(1 + rand() % 50);
+        std::vector<big_integer> divisors = {1, 2, 3, 10, big_integer(1) << (itn % 31), base - 1, base / 2, base / 2 + 1,
+                                             (base >> (itn % 16)) - rand() % 1000 - 1};
+        for (big_integer const &b : divisors)
+        {
+            std::pair<big_integer, big_integer> qr = divmod(a, b);
+            EXPECT_EQ(qr.first * b + qr.second, a);
+            EXPECT_GE(qr.second, 0);
+            EXPECT_LT(qr.second, b);
+            EXPECT_EQ(invariant_divisor(b).divmod(-a), divmod(-a, b));
+        }
+    }
+
+    // an empty dividend, for both the shift and the reciprocal path
+    digit_vector::digit_t empty[1] = {0};
+    EXPECT_EQ(digit_kernels::divrem_1(empty, empty, 0, 3), 0u);
+    EXPECT_EQ(digit_kernels::divrem_1(empty, empty, 0, 4), 0u);
+}
+
+TEST(correctness, shift_randomized)
+{
+    for (size_t itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        big_integer a = rand_big(rand() % 30);
+        if (itn % 2 == 1)
+        {
+            a = -a;
+        }
+        int bits = rand() % 1000;
+        big_integer power = 1;
+        for (int i = 0; i < bits; i++)
+        {
+            power *= 2;
+        }
+
+        EXPECT_EQ(a << bits, a * power);
+        big_integer quotient = a / power;
+        if (a < 0 && quotient * power != a)
+        {
+            quotient -= 1;
+        }
+        EXPECT_EQ(a >> bits, quotient);
+        EXPECT_EQ((a << bits) >> bits, a);
+        EXPECT_EQ(a >> -bits, a << bits);
+    }
+    EXPECT_EQ(big_integer(-4) >> 1, -2);
+    EXPECT_EQ(big_integer(-1) >> 1000, -1);
+    EXPECT_EQ(big_integer(0) << 1000, 0);
+}
+
+TEST(correctness, digit_vector_bulk_shifts)
+{
+    digit_vector a;
+    for (digit_vector::digit_t i = 1; i <= 10; i++)
+    {
+        a.push_back(i);
+    }
+    digit_vector shared = a;
+
+    a.drop_front(3);
+    ASSERT_EQ(a.size(), 7u);
+    EXPECT_EQ(a[0], 4u);
+    EXPECT_EQ(shared.size(), 10u);
+    EXPECT_EQ(shared[0], 1u);
+
+    a[0] = 42;
+    EXPECT_EQ(shared[3], 4u);
+
+    a.prepend_zeros(2);
+    ASSERT_EQ(a.size(), 9u);
+    EXPECT_EQ(a[0], 0u);
+    EXPECT_EQ(a[1], 0u);
+    EXPECT_EQ(a[2], 42u);
+    EXPECT_EQ(a[8], 10u);
+
+    a.push_back(11);
+    EXPECT_EQ(a.back(), 11u);
+    a.drop_front(100);
+    EXPECT_TRUE(a.empty());
+
+    digit_vector small;
+    small.push_back(5);
+    small.prepend_zeros(1);
+    ASSERT_EQ(small.size(), 2u);
+    EXPECT_EQ(small[1], 5u);
+}
+
+TEST(correctness, digit_vector_inline_boundary)
+{
+    const size_t n = digit_vector::INLINE_CAPACITY;
+    for (size_t size = std::max<size_t>(n, 3) - 1; size <= n + 1; size++)
+    {
+        digit_vector a;
+        for (size_t i = 0; i != size; i++)
+        {
+            a.push_back(i + 1);
+        }
+        digit_vector shared = a;
+
+        a.insert(a.begin(), 7);
+        ASSERT_EQ(a.size(), size + 1);
+        EXPECT_EQ(a[0], 7u);
+        EXPECT_EQ(a.back(), size);
+        a.erase(a.begin());
+        EXPECT_EQ(a, shared);
+
+        a.prepend_zeros(1);
+        a[1] = 42;
+        ASSERT_EQ(a.size(), size + 1);
+        EXPECT_EQ(a[0], 0u);
+        EXPECT_EQ(shared[0], 1u);
+
+        a.drop_front(2);
+        ASSERT_EQ(a.size(), size - 1);
+        for (size_t i = 0; i != a.size(); i++)
+        {
+            EXPECT_EQ(a[i], i + 2);
+        }
+        a.pop_back();
+        a.push_back(size);
+        shared.erase(shared.begin());
+        EXPECT_EQ(a, shared);
+    }
+
+    big_integer x = (big_integer(1) << (n * digit_vector::DIGIT_BASE)) - 1;
+    EXPECT_EQ(x + 1, big_integer(1) << (n * digit_vector::DIGIT_BASE));
+    EXPECT_EQ((x + 1) - 1, x);
+    EXPECT_EQ(x * x / x, x);
+    EXPECT_EQ(-x >> digit_vector::DIGIT_BASE, -(x >> digit_vector::DIGIT_BASE) - 1);
+}
+
+TEST(correctness, decimal_round_trip_long)
+{
+    std::vector<std::string> values = {"1" + std::string(5000, '0'), std::string(5000, '9'),
+                                       "1" + std::string(2500, '0') + "1" + std::string(2500, '0') + "1",
+                                       "-123456789" + std::string(1234, '0') + "987654321"};
+    for (size_t itn = 0; itn != 10; ++itn)
+    {
+        std::string random = std::to_string(1 + rand() % 9);
+        size_t length = 100 + rand() % 8000;
+        for (size_t i = 0; i != length; ++i)
+        {
+            random += (char) ('0' + (i % 97 < 30 ? 0 : rand() % 10));
+        }
+        values.push_back(random);
+    }
+
+    for (std::string const &value : values)
+    {
+        EXPECT_EQ(to_string(big_integer(value)), value);
+    }
+}
+
+TEST(correctness, decimal_validation)
+{
+    const char bad[] = {'/', ':', 'a', ' ', '+', '\0', (char) 0xb0, (char) 0xff};
+    for (size_t length = 1; length != 71; ++length)
+    {
+        std::string digits;
+        for (size_t i = 0; i != length; ++i)
+        {
+            digits += (char) ('0' + (i * 7 + 3) % 10);
+        }
+        std::string expected = digits.substr(digits.find_first_not_of('0'));
+        EXPECT_EQ(to_string(big_integer(digits)), expected);
+
+        for (size_t pos = 0; pos != length; ++pos)
+        {
+            std::string broken = digits;
+            broken[pos] = bad[(length + pos) % sizeof(bad)];
+            EXPECT_THROW(big_integer{broken}, std::invalid_argument);
+        }
+    }
+}
+
+TEST(correctness, radix_conversion)
+{
+    EXPECT_EQ(to_string(big_integer(255), 16), "ff");
+    EXPECT_EQ(to_string(big_integer(-255), 2), "-11111111");
+    EXPECT_EQ(to_string(big_integer(0), 7), "0");
+    EXPECT_EQ(to_string(big_integer(1295), 36), "zz");
+    EXPECT_EQ(from_string("ZZ", 36), 1295);
+    EXPECT_EQ(from_string("-7fFfFfFf", 16), -std::numeric_limits<int>::max());
+    EXPECT_EQ(from_string("-0", 8), 0);
+    EXPECT_EQ(from_string("1" + std::string(128, '0'), 2), big_integer(1) << 128);
+    EXPECT_EQ(to_string(big_integer(1) << 200, 32), "1" + std::string(40, '0'));
+
+    EXPECT_THROW(to_string(big_integer(1), 1), std::invalid_argument);
+    EXPECT_THROW(from_string("1", 37), std::invalid_argument);
+    EXPECT_THROW(from_string("102", 2), std::invalid_argument);
+    EXPECT_THROW(from_string("fg", 16), std::invalid_argument);
+    EXPECT_THROW(from_string("1 2", 3), std::invalid_argument);
+}
+
+TEST(correctness, radix_round_trip_randomized)
+{
+    for (int base = 2; base <= 36; ++base)
+    {
+        for (size_t itn = 0; itn != 20; ++itn)
+        {
+            big_integer value = rand() % 1000;
+            size_t words = (itn < 10 ? itn : 150 + rand() % 150);
+            for (size_t i = 0; i != words; ++i)
+            {
+                value = (value << 30) + rand();
+            }
+            if (itn % 2 == 1) value = -value;
+
+            // the digits by repeated division, lowest first
+            std::string expected;
+            for (big_integer rest = value.absolute(); rest != 0; rest /= base)
+            {
+                int digit = std::stoi(to_string(rest % base));
+                expected += "0123456789abcdefghijklmnopqrstuvwxyz"[digit];
+            }
+            if (expected.empty()) expected = "0";
+            if (value < 0) expected += '-';
+            std::reverse(expected.begin(), expected.end());
+
+            std::string str = to_string(value, base);
+            ASSERT_EQ(str, expected);
+            EXPECT_EQ(from_string(str, base), value);
+        }
+    }
+}
+
+TEST(correctness, to_chars_buffers)
+{
+    big_integer value = from_string("-123456789012345678901234567890", 10);
+    char buffer[64];
+
+    to_chars_result written = to_chars(buffer, buffer + sizeof(buffer), value);
+    EXPECT_EQ(written.ec, std::errc());
+    EXPECT_EQ(std::string(buffer, written.ptr), "-123456789012345678901234567890");
+
+    // exactly enough space, which is less than the estimate
+    ASSERT_LT(31u, to_chars_size(value));
+    written = to_chars(buffer, buffer + 31, value);
+    EXPECT_EQ(written.ec, std::errc());
+    EXPECT_EQ(written.ptr, buffer + 31);
+
+    written = to_chars(buffer, buffer + 30, value);
+    EXPECT_EQ(written.ec, std::errc::value_too_large);
+    EXPECT_EQ(written.ptr, buffer + 30);
+
+    written = to_chars(buffer, buffer + 1, big_integer(0), 16);
+    EXPECT_EQ(std::string(buffer, written.ptr), "0");
+    EXPECT_EQ(to_chars(buffer, buffer, big_integer(0)).ec, std::errc::value_too_large);
+
+    std::vector<char> exact;
+    for (int base = 2; base <= 36; ++base)
+    {
+        for (size_t itn = 0; itn != 12; ++itn)
+        {
+            big_integer x = rand() - RAND_MAX / 2;
+            for (size_t i = 0; i != (itn < 10 ? itn * 7 : itn * 30); ++i)
+            {
+                x = (x << 30) + rand();
+            }
+            std::string str = to_string(x, base);
+            EXPECT_LE(str.size(), to_chars_size(x, base));
+            EXPECT_LE(to_chars_size(x, base), str.size() + 2);
+            if ((base & (base - 1)) == 0)
+            {
+                EXPECT_EQ(str.size(), to_chars_size(x, base));
+            }
+
+            exact.assign(str.size(), '\0');
+            written = to_chars(exact.data(), exact.data() + exact.size(), x, base);
+            EXPECT_EQ(written.ec, std::errc());
+            EXPECT_EQ(std::string(exact.data(), written.ptr), str);
+            written = to_chars(exact.data(), exact.data() + exact.size() - 1, x, base);
+            EXPECT_EQ(written.ec, std::errc::value_too_large);
+        }
+    }
+}
+
+TEST(correctness, from_chars_prefix)
+{
+    big_integer value = 42;
+    std::string text = "-ffe0x12";
+    from_chars_result parsed = from_chars(text.data(), text.data() + text.size(), value, 16);
+    EXPECT_EQ(parsed.ec, std::errc());
+    EXPECT_EQ(parsed.ptr, text.data() + 5);
+    EXPECT_EQ(value, -0xffe0);
+
+    parsed = from_chars(text.data() + 6, text.data() + text.size(), value);
+    EXPECT_EQ(parsed.ptr, text.data() + text.size());
+    EXPECT_EQ(value, 12);
+
+    for (std::string bad : {"", "-", "x1", "+1", "-z"})
+    {
+        parsed = from_chars(bad.data(), bad.data() + bad.size(), value);
+        EXPECT_EQ(parsed.ec, std::errc::invalid_argument);
+        EXPECT_EQ(parsed.ptr, bad.data());
+        EXPECT_EQ(value, 12);
+    }
+
+    std::string digits = "9" + std::string(3000, '1') + " tail";
+    parsed = from_chars(digits.data(), digits.data() + digits.size(), value);
+    EXPECT_EQ(parsed.ptr, digits.data() + 3001);
+    EXPECT_EQ(value, big_integer(digits.substr(0, 3001)));
+}
+
+TEST(correctness, binary_layout)
+{
+    big_integer value = -((big_integer(1) << 64) + from_string("0807060504030201", 16));
+    std::vector<unsigned char> bytes(binary_size(value));
+    EXPECT_EQ(to_binary(value, bytes.data()), bytes.data() + bytes.size());
+
+    // three words, padded to whole digits
+    size_t words = (bytes.size() - BINARY_HEADER_SIZE) / 4;
+    ASSERT_GE(words, 3u);
+    std::vector<unsigned char> expected = {1, 1, 0, 0, (unsigned char) words, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 1};
+    expected.resize(bytes.size());
+    EXPECT_EQ(bytes, expected);
+
+    // a value written with 32-bit digits reads the same with either width
+    std::vector<unsigned char> narrow = {1, 1, 0, 0, 3, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 1, 0, 0, 0};
+    big_integer read;
+    EXPECT_EQ(from_binary(narrow.data(), narrow.data() + narrow.size(), read), narrow.data() + narrow.size());
+    EXPECT_EQ(read, value);
+
+    EXPECT_THROW(from_binary(narrow.data(), narrow.data() + narrow.size() - 1, read), std::invalid_argument);
+    EXPECT_THROW(from_binary(narrow.data(), narrow.data() + 7, read), std::invalid_argument);
+    narrow[0] = 2;
+    EXPECT_THROW(from_binary(narrow.data(), narrow.data() + narrow.size(), read), std::invalid_argument);
+    EXPECT_EQ(read, value);
+}
+
+TEST(correctness, binary_round_trip_randomized)
+{
+    std::vector<big_integer> values = {0, 1, -1};
+    for (size_t itn = 0; itn != 50; ++itn)
+    {
+        big_integer x = rand();
+        size_t words = (itn < 25 ? itn : rand() % 2000);
+        for (size_t i = 0; i != words; ++i)
+        {
+            x = (x << 30) + rand();
+        }
+        values.push_back(itn % 2 == 0 ? x : -x);
+    }
+
+    // all values back to back in one buffer
+    std::vector<unsigned char> bytes;
+    for (big_integer const &x : values)
+    {
+        size_t offset = bytes.size();
+        bytes.resize(offset + binary_size(x));
+        to_binary(x, bytes.data() + offset);
+
+        binary_view view(x);
+        EXPECT_TRUE(std::equal(view.header(), view.header() + BINARY_HEADER_SIZE, bytes.data() + offset));
+        EXPECT_EQ(BINARY_HEADER_SIZE + view.limbs_size(), binary_size(x));
+        EXPECT_TRUE(std::equal(view.limbs(), view.limbs() + view.limbs_size(), bytes.data() + offset + BINARY_HEADER_SIZE));
+    }
+
+    const unsigned char *pos = bytes.data();
+    for (big_integer const &x : values)
+    {
+        big_integer read;
+        pos = from_binary(pos, bytes.data() + bytes.size(), read);
+        EXPECT_EQ(read, x);
+    }
+    EXPECT_EQ(pos, bytes.data() + bytes.size());
+}
+
+TEST(correctness, binary_view_keeps_snapshot)
+{
+    big_integer value = (big_integer(1) << 1000) - 1;
+    binary_view view(value);
+    std::vector<unsigned char> before(view.limbs(), view.limbs() + view.limbs_size());
+
+    value += 1;
+    EXPECT_TRUE(std::equal(before.begin(), before.end(), view.limbs()));
+    EXPECT_EQ(view.limbs()[0], 0xff);
+}
+
+namespace
+{
+    // a file name no other run uses, removed when it goes out of scope
+    struct temporary_file
+    {
+        std::string path;
+
+        temporary_file()
+        {
+            char const *dir = std::getenv("TMPDIR");
+            path = std::string(dir != nullptr ? dir : ".") + "/big_integer_" +
+                   std::to_string(std::random_device()()) + "_" +
+                   std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".bin";
+        }
+
+        ~temporary_file()
+        {
+            std::remove(path.c_str());
+        }
+    };
+}
+
+TEST(correctness, mapped_file_borrows)
+{
+    std::vector<big_integer> values = {0, -1};
+    for (size_t itn = 0; itn != 30; ++itn)
+    {
+        big_integer x = rand();
+        for (size_t i = 0; i != itn * 5; ++i)
+        {
+            x = (x << 30) + rand();
+        }
+        values.push_back(itn % 3 == 0 ? -x : x);
+    }
+
+    std::vector<unsigned char> bytes;
+    for (big_integer const &x : values)
+    {
+        size_t offset = bytes.size();
+        bytes.resize(offset + binary_size(x));
+        to_binary(x, bytes.data() + offset);
+    }
+    // an odd number of words, which 64-bit digits cannot borrow
+    std::vector<unsigned char> odd = {1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0};
+    bytes.insert(bytes.end(), odd.begin(), odd.end());
+    values.push_back((big_integer(3) << 64) + (big_integer(2) << 32) + 1);
+
+    temporary_file file;
+    std::string const &path = file.path;
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+
+    big_integer inline_limit = big_integer(1) << (digit_vector::INLINE_CAPACITY * digit_vector::DIGIT_BASE);
+    for (bool borrow : {true, false})
+    {
+        mapped_binary_file mapped(path);
+        std::vector<big_integer> read = mapped.read_all(borrow);
+        ASSERT_EQ(read.size(), values.size());
+        for (size_t i = 0; i != values.size(); ++i)
+        {
+            EXPECT_EQ(read[i], values[i]);
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            // every record is aligned and only the last one has whole 64-bit digits missing, so
+            // the other values too long to be stored inline keep their digits in the mapping
+            const unsigned char *limbs = binary_view(read[i]).limbs();
+            bool in_mapping = !std::less<const unsigned char *>()(limbs, mapped.begin()) &&
+                              std::less<const unsigned char *>()(limbs, mapped.end());
+            bool whole_digits = (i + 1 != values.size() || digit_vector::DIGIT_BASE == 32);
+            EXPECT_EQ(in_mapping, borrow && whole_digits && read[i].absolute() >= inline_limit);
+#endif
+
+            // the mapping is read-only, so changes must not happen in place
+            big_integer copy = read[i];
+            read[i] += 1;
+            read[i] -= 1;
+            read[i] <<= 64;
+            read[i] >>= 64;
+            read[i] = -read[i];
+            EXPECT_EQ(read[i], -values[i]);
+            EXPECT_EQ(copy, values[i]);
+        }
+    }
+
+    // the only value left holding the mapping
+    big_integer last = mapped_binary_file(path).read_all()[values.size() - 2];
+    last -= 1;
+    EXPECT_EQ(last, values[values.size() - 2] - 1);
+
+    // in-place shifts of a value that is the last owner of its digits, both from a mapping and
+    // from released storage, by less and by more than a digit
+    big_integer const &large = values[values.size() - 2];
+    auto from_mapping = [&path, &values] { return mapped_binary_file(path).read_all()[values.size() - 2]; };
+    auto from_storage = [&large] {
+        size_t size = binary_size(large);
+        std::shared_ptr<digit_vector::digit_t> buffer(new digit_vector::digit_t[size / sizeof(digit_vector::digit_t) + 1],
+                                                      std::default_delete<digit_vector::digit_t[]>());
+        auto *bytes = reinterpret_cast<unsigned char *>(buffer.get());
+        to_binary(large, bytes);
+        big_integer value;
+        from_binary(bytes, bytes + size, value, std::shared_ptr<const unsigned char>(buffer, bytes));
+        return value;
+    };
+    for (int shift : {3, (int) digit_vector::DIGIT_BASE + 3})
+    {
+        big_integer power = big_integer(1) << shift;
+        for (std::function<big_integer()> const &source : {std::function<big_integer()>(from_mapping),
+                                                            std::function<big_integer()>(from_storage)})
+        {
+            big_integer x = source();
+            x <<= shift;
+            EXPECT_EQ(x, large * power);
+            x = source();
+            x >>= shift;
+            EXPECT_EQ(x, large / power);
+        }
+    }
+
+    mapped_binary_file first(path);
+    EXPECT_EQ(first.read(), values[0]);
+    EXPECT_FALSE(first.at_end());
+    std::remove(path.c_str());
+
+    EXPECT_THROW(mapped_binary_file{path}, std::system_error);
+}
+
+TEST(correctness, stream_input)
+{
+    std::istringstream in("  42 -17\n123abc -x");
+    big_integer a, b, c, d = 5;
+    in >> a >> b >> c;
+    EXPECT_EQ(a, 42);
+    EXPECT_EQ(b, -17);
+    EXPECT_EQ(c, 123);
+    EXPECT_EQ(in.get(), 'a');
+    in.ignore(2);
+    EXPECT_FALSE(in >> d);
+    EXPECT_EQ(d, 5);
+    in.clear();
+    EXPECT_EQ(in.get(), 'x');
+
+    std::istringstream hex("-fF 10");
+    hex >> std::hex >> a >> std::oct >> b;
+    EXPECT_EQ(a, -255);
+    EXPECT_EQ(b, 8);
+    EXPECT_TRUE(hex.eof());
+
+    std::ostringstream out;
+    out << std::hex << a << ' ' << std::oct << b << ' ' << std::dec << b;
+    EXPECT_EQ(out.str(), "-ff 10 8");
+}
+
+TEST(correctness, stream_input_long)
+{
+    for (int base : {10, 16, 8})
+    {
+        std::string digits = "1";
+        for (size_t i = 0; i != 300000; ++i)
+        {
+            digits += "0123456789abcdef"[rand() % base];
+        }
+        std::istringstream in(digits + " -" + digits);
+        in.setf(base == 16 ? std::ios::hex : base == 8 ? std::ios::oct : std::ios::dec, std::ios::basefield);
+
+        big_integer a, b;
+        in >> a >> b;
+        EXPECT_EQ(a, from_string(digits, base));
+        EXPECT_EQ(b, -a);
+        EXPECT_TRUE(in.eof());
+    }
+
+    // whole blocks of either digit width
+    for (size_t length : {9 * 1024 * 4, 19 * 1024 * 2, 19 * 1024 * 3 + 1})
+    {
+        std::string digits(length, '0');
+        for (char &digit : digits)
+        {
+            digit = (char) ('0' + rand() % 10);
+        }
+        digits[0] = '7';
+        std::istringstream in(digits);
+        big_integer a;
+        in >> a;
+        EXPECT_EQ(a, big_integer(digits));
+    }
+}
+
+TEST(correctness, compact_encoding)
+{
+    auto encode = [](big_integer const &x) {
+        std::vector<unsigned char> bytes(compact_size(x));
+        EXPECT_EQ(to_compact(x, bytes.data()), bytes.data() + bytes.size());
+        big_integer read;
+        EXPECT_EQ(from_compact(bytes.data(), bytes.data() + bytes.size(), read), bytes.data() + bytes.size());
+        EXPECT_EQ(read, x);
+        return bytes;
+    };
+
+    EXPECT_EQ(encode(0), std::vector<unsigned char>({0x00}));
+    EXPECT_EQ(encode(-1), std::vector<unsigned char>({0x01}));
+    EXPECT_EQ(encode(1), std::vector<unsigned char>({0x02}));
+    EXPECT_EQ(encode(-64), std::vector<unsigned char>({0x7f}));
+    EXPECT_EQ(encode(64), std::vector<unsigned char>({0x80, 0x01}));
+    EXPECT_EQ(encode(300), std::vector<unsigned char>({0xd8, 0x04}));
+
+    big_integer limit = big_integer(1) << 62;
+    EXPECT_EQ(encode(limit - 1).size(), 9u);
+    EXPECT_EQ(encode(-limit).size(), 9u);
+    std::vector<unsigned char> large = encode(limit);
+    EXPECT_EQ(large[0], 0x80);
+    EXPECT_EQ(large[1], 0x00);
+    EXPECT_EQ(encode(-(big_integer(1) << 100)).size(), 2 + 1 + (large.size() - 3) * 2);
+
+    big_integer read = 7;
+    std::vector<unsigned char> bad = {0x80, 0x80};
+    EXPECT_THROW(from_compact(bad.data(), bad.data() + bad.size(), read), std::invalid_argument);
+    bad = {0x80, 0x00, 0x04, 1, 2, 3, 4};
+    EXPECT_THROW(from_compact(bad.data(), bad.data() + bad.size(), read), std::invalid_argument);
+    bad = std::vector<unsigned char>(9, 0xff);
+    bad.push_back(0x00);
+    EXPECT_THROW(from_compact(bad.data(), bad.data() + bad.size(), read), std::invalid_argument);
+    // a tenth byte of the long form's length carries a single bit
+    bad = {0x80, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02};
+    EXPECT_THROW(from_compact(bad.data(), bad.data() + bad.size(), read), std::invalid_argument);
+    EXPECT_EQ(read, 7);
+}
+
+TEST(correctness, compact_batch_randomized)
+{
+    std::vector<big_integer> values;
+    for (size_t itn = 0; itn != 1000; ++itn)
+    {
+        big_integer x = rand() % 1000 - 500;
+        size_t words = (itn % 10 == 0 ? rand() % 100 : rand() % 3);
+        for (size_t i = 0; i != words; ++i)
+        {
+            x = (x << 30) + rand();
+        }
+        values.push_back(x);
+    }
+
+    std::vector<unsigned char> bytes(compact_size(values.data(), values.data() + values.size()));
+    EXPECT_EQ(to_compact(values.data(), values.data() + values.size(), bytes.data()), bytes.data() + bytes.size());
+
+    std::vector<big_integer> read(values.size());
+    EXPECT_EQ(from_compact(bytes.data(), bytes.data() + bytes.size(), read.data(), read.size()),
+              bytes.data() + bytes.size());
+    EXPECT_EQ(read, values);
+}
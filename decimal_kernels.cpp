@@ -0,0 +1,162 @@
+#include "decimal_kernels.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BIGINT_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define BIGINT_SWAR_DIGITS
+#endif
+
+namespace decimal_kernels {
+    namespace {
+        bool is_digit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        uint64_t parse_scalar(const char *first, std::size_t n) {
+            uint64_t value = 0;
+            for (std::size_t i = 0; i < n; i++) value = value * 10 + (first[i] - '0');
+            return value;
+        }
+
+#ifdef BIGINT_SWAR_DIGITS
+        // Eight characters in a little-endian word, the first one in the lowest byte
+
+        uint64_t load_8(const char *first) {
+            uint64_t word;
+            std::memcpy(&word, first, sizeof(word));
+            return word;
+        }
+
+        // adding 0x46 carries into the top bit of a byte above '9', subtracting 0x30 borrows into it below '0'
+        bool eight_digits(uint64_t word) {
+            return (((word + 0x4646464646464646) | (word - 0x3030303030303030)) & 0x8080808080808080) == 0;
+        }
+
+        // pairs, then quadruples of digits are combined by one multiplication each
+        uint32_t parse_8(const char *first) {
+            uint64_t word = load_8(first) - 0x3030303030303030;
+            word = word * 10 + (word >> 8);
+            word = ((word & 0x000000ff000000ff) * (100 + (1000000ull << 32)) +
+                    ((word >> 16) & 0x000000ff000000ff) * (1 + (10000ull << 32))) >> 32;
+            return (uint32_t) word;
+        }
+
+        bool all_digits_swar(const char *first, const char *last) {
+            for (; last - first >= 8; first += 8) {
+                if (!eight_digits(load_8(first))) return false;
+            }
+            for (; first != last; first++) {
+                if (!is_digit(*first)) return false;
+            }
+            return true;
+        }
+
+        uint64_t parse_chunk_swar(const char *first, std::size_t n) {
+            std::size_t head = n % 8;
+            uint64_t value = parse_scalar(first, head);
+            for (std::size_t i = head; i < n; i += 8) value = value * 100000000 + parse_8(first + i);
+            return value;
+        }
+#else
+        bool all_digits_swar(const char *first, const char *last) {
+            for (; first != last; first++) {
+                if (!is_digit(*first)) return false;
+            }
+            return true;
+        }
+
+        uint64_t parse_chunk_swar(const char *first, std::size_t n) {
+            return parse_scalar(first, n);
+        }
+#endif
+
+#ifdef BIGINT_X86_DISPATCH
+        // SSE2 is part of x86-64, so this one needs no check. The comparisons are signed,
+        // which also rejects the characters above 127
+        bool all_digits_sse2(const char *first, const char *last) {
+            const __m128i below = _mm_set1_epi8('0' - 1), above = _mm_set1_epi8('9' + 1);
+            for (; last - first >= 16; first += 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+                __m128i good = _mm_and_si128(_mm_cmpgt_epi8(chunk, below), _mm_cmpgt_epi8(above, chunk));
+                if (_mm_movemask_epi8(good) != 0xffff) return false;
+            }
+            return all_digits_swar(first, last);
+        }
+
+        __attribute__((target("avx2")))
+        bool all_digits_avx2(const char *first, const char *last) {
+            const __m256i below = _mm256_set1_epi8('0' - 1), above = _mm256_set1_epi8('9' + 1);
+            for (; last - first >= 32; first += 32) {
+                __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+                __m256i good = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, below), _mm256_cmpgt_epi8(above, chunk));
+                if (_mm256_movemask_epi8(good) != -1) return false;
+            }
+            // the tail stays in this function: calling the SSE2 version with the upper halves of
+            // the registers dirty costs a state transition on every call
+            if (last - first >= 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+                __m128i good = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm256_castsi256_si128(below)),
+                                             _mm_cmpgt_epi8(_mm256_castsi256_si128(above), chunk));
+                if (_mm_movemask_epi8(good) != 0xffff) return false;
+                first += 16;
+            }
+            for (; first != last; first++) {
+                if (!is_digit(*first)) return false;
+            }
+            return true;
+        }
+
+        // Sixteen digits at once: adjacent digits, then pairs and quadruples of them are
+        // combined by multiply-add instructions into two 8-digit halves
+        __attribute__((target("sse4.1")))
+        uint64_t parse_chunk_sse41(const char *first, std::size_t n) {
+            if (n < 16) return parse_chunk_swar(first, n);
+
+            std::size_t head = n - 16;
+            uint64_t value = parse_chunk_swar(first, head);
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + head));
+            chunk = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+            __m128i pairs = _mm_maddubs_epi16(chunk, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1,
+                                                                   10, 1, 10, 1, 10, 1, 10, 1));
+            __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+            quads = _mm_packus_epi32(quads, quads);
+            __m128i octets = _mm_madd_epi16(quads, _mm_setr_epi16(10000, 1, 10000, 1, 0, 0, 0, 0));
+            auto high = (uint32_t) _mm_cvtsi128_si32(octets);
+            auto low = (uint32_t) _mm_extract_epi32(octets, 1);
+            return (value * 100000000 + high) * 100000000 + low;
+        }
+#endif
+
+        struct implementation {
+            bool (*all_digits)(const char *first, const char *last);
+            uint64_t (*parse_chunk)(const char *first, std::size_t n);
+        };
+
+        implementation select() {
+            implementation res = {all_digits_swar, parse_chunk_swar};
+#ifdef BIGINT_X86_DISPATCH
+            res.all_digits = (__builtin_cpu_supports("avx2") ? all_digits_avx2 : all_digits_sse2);
+            if (__builtin_cpu_supports("sse4.1")) res.parse_chunk = parse_chunk_sse41;
+#endif
+            return res;
+        }
+
+        implementation const &selected() {
+            static const implementation res = select();
+            return res;
+        }
+    }
+
+    bool all_digits(const char *first, const char *last) {
+        return selected().all_digits(first, last);
+    }
+
+    uint64_t parse_chunk(const char *first, std::size_t n) {
+        return selected().parse_chunk(first, n);
+    }
+}
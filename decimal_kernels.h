@@ -0,0 +1,18 @@
+#ifndef BIGINTEGER_DECIMAL_KERNELS_H
+#define BIGINTEGER_DECIMAL_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Validation and conversion of ASCII decimal digits. On x86-64 the widest instruction set
+// the CPU supports is picked at run time, other targets work on 8 characters at once in
+// a 64-bit word.
+namespace decimal_kernels {
+    // whether [first, last) consists of the characters '0'..'9' only
+    bool all_digits(const char *first, const char *last);
+
+    // the value of the n <= 19 decimal digits starting at first
+    uint64_t parse_chunk(const char *first, std::size_t n);
+}
+
+#endif // BIGINTEGER_DECIMAL_KERNELS_H
@@ -0,0 +1,570 @@
+#include "digit_kernels.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+namespace digit_kernels {
+    std::size_t karatsuba_threshold = 32;
+    std::size_t toom3_threshold = 192;
+    std::size_t toom4_threshold = 512;
+    std::size_t ntt_threshold = 16384;
+    std::size_t parallel_threshold = 2048;
+    std::size_t bz_threshold = 40;
+    std::size_t newton_threshold = 65536;
+    std::size_t invariant_newton_threshold = 8192;
+
+    namespace {
+        std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        std::unique_ptr<thread_pool> pool;
+        std::mutex pool_mutex;
+
+        thread_pool *shared_pool() {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (threads <= 1) return nullptr;
+            if (!pool) pool.reset(new thread_pool(threads - 1));
+            return pool.get();
+        }
+    }
+
+    void set_thread_count(std::size_t count) {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        threads = std::max<std::size_t>(count, 1);
+        pool.reset();
+    }
+
+    std::size_t thread_count() {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        return threads;
+    }
+
+    void run_parallel(std::size_t size, std::vector<std::function<void()>> const &tasks) {
+        thread_pool *workers = (size >= parallel_threshold ? shared_pool() : nullptr);
+        if (workers != nullptr) {
+            workers->run(tasks);
+        } else {
+            for (auto const &task : tasks) task();
+        }
+    }
+
+    digit_t add_n(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n) {
+        digit_t carry = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            double_digit_t cur = (double_digit_t) a[i] + b[i] + carry;
+            r[i] = (digit_t) cur;
+            carry = (digit_t) (cur >> digit_vector::DIGIT_BASE);
+        }
+        return carry;
+    }
+
+    digit_t sub_n(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n) {
+        digit_t borrow = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            digit_t x = a[i], y = b[i];
+            digit_t d = x - y;
+            digit_t next_borrow = (digit_t) (x < y);
+            next_borrow |= (digit_t) (d < borrow);
+            r[i] = d - borrow;
+            borrow = next_borrow;
+        }
+        return borrow;
+    }
+
+    digit_t add_1(digit_t *r, const digit_t *a, std::size_t n, digit_t c) {
+        std::size_t i = 0;
+        for (; i < n && c > 0; i++) {
+            r[i] = a[i] + c;
+            c = (digit_t) (r[i] < c);
+        }
+        if (r != a) std::copy(a + i, a + n, r + i);
+        return c;
+    }
+
+    digit_t sub_1(digit_t *r, const digit_t *a, std::size_t n, digit_t c) {
+        std::size_t i = 0;
+        for (; i < n && c > 0; i++) {
+            digit_t x = a[i];
+            r[i] = x - c;
+            c = (digit_t) (x < c);
+        }
+        if (r != a) std::copy(a + i, a + n, r + i);
+        return c;
+    }
+
+    digit_t add(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        digit_t carry = add_n(r, a, b, bn);
+        return add_1(r + bn, a + bn, an - bn, carry);
+    }
+
+    digit_t sub(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        digit_t borrow = sub_n(r, a, b, bn);
+        return sub_1(r + bn, a + bn, an - bn, borrow);
+    }
+
+    void fold(digit_t *r, const digit_t *a, std::size_t an, std::size_t n) {
+        std::size_t first = std::min(an, n);
+        std::copy(a, a + first, r);
+        std::fill(r + first, r + n, 0);
+
+        // B^n = 1 modulo B^n - 1, so the carries wrap around to the lowest digit
+        digit_t carry = 0;
+        for (std::size_t pos = n; pos < an; pos += n) {
+            carry += add(r, r, n, a + pos, std::min(n, an - pos));
+        }
+        while (carry > 0) carry = add_1(r, r, n, carry);
+    }
+
+    int cmp(const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        if (an != bn) return an < bn ? -1 : 1;
+        for (std::size_t i = an; i > 0; i--) {
+            if (a[i - 1] != b[i - 1]) return a[i - 1] < b[i - 1] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    digit_t mul_1(digit_t *r, const digit_t *a, std::size_t n, digit_t b) {
+        digit_t carry = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            double_digit_t cur = (double_digit_t) a[i] * b + carry;
+            r[i] = (digit_t) cur;
+            carry = (digit_t) (cur >> digit_vector::DIGIT_BASE);
+        }
+        return carry;
+    }
+
+    digit_t addmul_1(digit_t *r, const digit_t *a, std::size_t n, digit_t b) {
+        digit_t carry = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            double_digit_t cur = (double_digit_t) a[i] * b + r[i] + carry;
+            r[i] = (digit_t) cur;
+            carry = (digit_t) (cur >> digit_vector::DIGIT_BASE);
+        }
+        return carry;
+    }
+
+    digit_t submul_1(digit_t *r, const digit_t *a, std::size_t n, digit_t b) {
+        digit_t borrow = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            double_digit_t cur = (double_digit_t) a[i] * b + borrow;
+            auto low = (digit_t) cur;
+            borrow = (digit_t) (cur >> digit_vector::DIGIT_BASE);
+            digit_t x = r[i];
+            r[i] = x - low;
+            borrow += (digit_t) (x < low);
+        }
+        return borrow;
+    }
+
+    digit_t lshift(digit_t *r, const digit_t *a, std::size_t n, unsigned s) {
+        digit_t out = 0;
+        for (std::size_t i = n; i > 0; i--) {
+            digit_t cur = a[i - 1];
+            if (i == n) out = cur >> (digit_vector::DIGIT_BASE - s);
+            r[i - 1] = (cur << s) | (i > 1 ? a[i - 2] >> (digit_vector::DIGIT_BASE - s) : 0);
+        }
+        return out;
+    }
+
+    digit_t rshift(digit_t *r, const digit_t *a, std::size_t n, unsigned s) {
+        digit_t out = (n > 0 ? a[0] << (digit_vector::DIGIT_BASE - s) : 0);
+        for (std::size_t i = 0; i < n; i++) {
+            r[i] = (a[i] >> s) | (i + 1 < n ? a[i + 1] << (digit_vector::DIGIT_BASE - s) : 0);
+        }
+        return out;
+    }
+
+    void divexact_1(digit_t *r, const digit_t *a, std::size_t n, digit_t d) {
+        unsigned shift = 0;
+        while ((d & 1) == 0) {
+            d >>= 1;
+            shift++;
+        }
+        if (shift > 0) {
+            rshift(r, a, n, shift);
+            a = r;
+        }
+
+        // d^-1 mod B by Newton's iteration, every step doubles the number of correct low bits
+        digit_t inverse = d;
+        for (int bits = 3; bits < digit_vector::DIGIT_BASE; bits *= 2) {
+            inverse *= 2 - d * inverse;
+        }
+
+        digit_t carry = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            digit_t s = a[i];
+            digit_t x = s - carry;
+            carry = (digit_t) (x > s);
+            digit_t q = x * inverse;
+            r[i] = q;
+            carry += (digit_t) (((double_digit_t) q * d) >> digit_vector::DIGIT_BASE);
+        }
+    }
+
+    void mul_basecase(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        r[an] = mul_1(r, a, an, b[0]);
+        for (std::size_t j = 1; j < bn; j++) {
+            r[an + j] = addmul_1(r + j, a, an, b[j]);
+        }
+    }
+
+    void sqr_basecase(digit_t *r, const digit_t *a, std::size_t n) {
+        // the products a[i] a[j], i < j, are summed once and doubled
+        std::fill(r, r + 2 * n, 0);
+        for (std::size_t i = 0; i + 1 < n; i++) {
+            r[i + n] = addmul_1(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+        }
+        r[2 * n - 1] = lshift(r + 1, r + 1, 2 * n - 2, 1);
+
+        digit_t carry = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            double_digit_t square = (double_digit_t) a[i] * a[i];
+            double_digit_t low = (double_digit_t) r[2 * i] + (digit_t) square + carry;
+            r[2 * i] = (digit_t) low;
+            double_digit_t high = (double_digit_t) r[2 * i + 1] + (digit_t) (square >> digit_vector::DIGIT_BASE)
+                                  + (digit_t) (low >> digit_vector::DIGIT_BASE);
+            r[2 * i + 1] = (digit_t) high;
+            carry = (digit_t) (high >> digit_vector::DIGIT_BASE);
+        }
+    }
+
+    void sqr(digit_t *r, const digit_t *a, std::size_t n) {
+        mul(r, a, n, a, n);
+    }
+
+    namespace {
+        // r[0..n) = |x[0..xn) - y[0..yn)|, n = max(xn, yn), returns true if x < y
+        bool abs_sub(digit_t *r, const digit_t *x, std::size_t xn, const digit_t *y, std::size_t yn) {
+            std::size_t n = std::max(xn, yn);
+            bool less = false;
+            for (std::size_t i = n; i > 0; i--) {
+                digit_t xi = (i <= xn ? x[i - 1] : 0);
+                digit_t yi = (i <= yn ? y[i - 1] : 0);
+                if (xi != yi) {
+                    less = xi < yi;
+                    break;
+                }
+            }
+            if (less) {
+                std::swap(x, y);
+                std::swap(xn, yn);
+            }
+            // x >= y, so the digits of y above xn are zeros
+            sub(r, x, xn, y, std::min(xn, yn));
+            std::fill(r + xn, r + n, 0);
+            return less;
+        }
+
+        std::size_t karatsuba_scratch_size(std::size_t n) {
+            std::size_t size = 0;
+            while (n >= karatsuba_threshold) {
+                std::size_t high = n - n / 2;
+                size += 4 * high + 1;
+                n = high;
+            }
+            return size;
+        }
+
+        void mul_n(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n, digit_t *scratch);
+
+        // Karatsuba multiplication of n-digit operands, r[0..2n) = a * b:
+        // a * b = z0 + (z0 + z2 - (a0 - a1)(b0 - b1)) B^h + z2 B^2h
+        void karatsuba(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n, digit_t *scratch) {
+            std::size_t h = n / 2, hh = n - h;
+
+            digit_t *da = scratch;          // hh digits, later the middle term of 2hh + 1 digits
+            digit_t *db = scratch + hh;     // hh digits
+            digit_t *z1 = scratch + 2 * hh + 1;
+            digit_t *next = z1 + 2 * hh;
+
+            // squaring keeps a == b down the recursion, (a0 - a1)^2 is never negative
+            bool neg = abs_sub(da, a, h, a + h, hh);
+            if (a == b) {
+                db = da;
+                neg = false;
+            } else {
+                neg ^= abs_sub(db, b, h, b + h, hh);
+            }
+
+            mul_n(z1, da, db, hh, next);
+            mul_n(r, a, b, h, next);
+            mul_n(r + 2 * h, a + h, b + h, hh, next);
+
+            digit_t *mid = scratch;
+            mid[2 * hh] = add(mid, r + 2 * h, 2 * hh, r, 2 * h);
+            if (neg) {
+                mid[2 * hh] += add_n(mid, mid, z1, 2 * hh);
+            } else {
+                mid[2 * hh] -= sub_n(mid, mid, z1, 2 * hh);
+            }
+            add(r + h, r + h, h + 2 * hh, mid, 2 * hh + 1);
+        }
+
+        // Karatsuba below toom3_threshold, scratch holds karatsuba_scratch_size(n) digits
+        void mul_n(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n, digit_t *scratch) {
+            if (n < karatsuba_threshold) {
+                if (a == b) {
+                    sqr_basecase(r, a, n);
+                } else {
+                    mul_basecase(r, a, n, b, n);
+                }
+            } else {
+                karatsuba(r, a, b, n, scratch);
+            }
+        }
+
+        void mul_balanced(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n);
+
+        // MARK: Toom-Cook
+
+        // Intermediate values of the Toom-Cook interpolation are signed, they are kept
+        // as fixed width two's complement numbers
+        typedef std::vector<digit_t> signed_digits;
+
+        bool is_negative(signed_digits const &w) {
+            return (w.back() >> (digit_vector::DIGIT_BASE - 1)) != 0;
+        }
+
+        void negate(signed_digits &w) {
+            for (digit_t &digit : w) digit = ~digit;
+            add_1(w.data(), w.data(), w.size(), 1);
+        }
+
+        void shift_right(signed_digits &w, unsigned s) {
+            bool neg = is_negative(w);
+            rshift(w.data(), w.data(), w.size(), s);
+            if (neg) w.back() |= ~(digit_vector::DIGIT_MASK >> s);
+        }
+
+        signed_digits operator+(signed_digits a, signed_digits const &b) {
+            add_n(a.data(), a.data(), b.data(), a.size());
+            return a;
+        }
+
+        signed_digits operator-(signed_digits a, signed_digits const &b) {
+            sub_n(a.data(), a.data(), b.data(), a.size());
+            return a;
+        }
+
+        signed_digits times(signed_digits a, digit_t c) {
+            mul_1(a.data(), a.data(), a.size(), c);
+            return a;
+        }
+
+        // a - b * c
+        signed_digits submul(signed_digits a, signed_digits const &b, digit_t c) {
+            submul_1(a.data(), b.data(), a.size(), c);
+            return a;
+        }
+
+        signed_digits divexact(signed_digits a, digit_t d) {
+            divexact_1(a.data(), a.data(), a.size(), d);
+            return a;
+        }
+
+        signed_digits shifted_right(signed_digits a, unsigned s) {
+            shift_right(a, s);
+            return a;
+        }
+
+        // Splitting of an n-digit operand into `parts` pieces of k digits, the last one is shorter
+        struct toom_split {
+            std::size_t n, parts, k, width;
+
+            toom_split(std::size_t n, std::size_t parts)
+                    : n(n), parts(parts), k((n + parts - 1) / parts), width(2 * k + 4) {}
+
+            const digit_t *piece(const digit_t *a, std::size_t i) const {
+                return a + i * k;
+            }
+
+            std::size_t piece_size(std::size_t i) const {
+                return i + 1 < parts ? k : n - i * k;
+            }
+
+            // Magnitude of the value at a small point by Horner's scheme in res[0..k + 1),
+            // returns true if it is negative. With `reversed` the pieces are taken in the opposite
+            // order, which evaluates 2^(parts - 1) a(1 / point)
+            bool evaluate(digit_t *res, const digit_t *a, int point, bool reversed) const {
+                signed_digits w(k + 2, 0);
+                auto factor = (digit_t) (point < 0 ? -point : point);
+                for (std::size_t step = 0; step < parts; step++) {
+                    std::size_t i = reversed ? step : parts - 1 - step;
+                    mul_1(w.data(), w.data(), w.size(), factor);
+                    if (point < 0) negate(w);
+                    add(w.data(), w.data(), w.size(), piece(a, i), piece_size(i));
+                }
+                bool neg = is_negative(w);
+                if (neg) negate(w);
+                std::copy(w.begin(), w.begin() + k + 1, res);
+                return neg;
+            }
+
+            signed_digits product_at(const digit_t *a, const digit_t *b, int point, bool reversed = false) const {
+                signed_digits w(width, 0);
+                std::vector<digit_t> x(k + 1);
+                bool neg = evaluate(x.data(), a, point, reversed);
+                if (a == b) {
+                    mul_balanced(w.data(), x.data(), x.data(), k + 1);
+                    return w;
+                }
+
+                std::vector<digit_t> y(k + 1);
+                neg ^= evaluate(y.data(), b, point, reversed);
+                mul_balanced(w.data(), x.data(), y.data(), k + 1);
+                if (neg) negate(w);
+                return w;
+            }
+
+            // Multiplies the lowest and the highest pieces directly into their places in r and
+            // clears the space in between, returns them as signed values
+            std::pair<signed_digits, signed_digits> products_at_ends(digit_t *r, const digit_t *a, const digit_t *b) const {
+                std::size_t last = piece_size(parts - 1);
+                digit_t *high = r + 2 * (parts - 1) * k;
+
+                mul_balanced(r, a, b, k);
+                mul_balanced(high, piece(a, parts - 1), piece(b, parts - 1), last);
+                std::fill(r + 2 * k, high, 0);
+
+                signed_digits low_value(width, 0), high_value(width, 0);
+                std::copy(r, r + 2 * k, low_value.begin());
+                std::copy(high, high + 2 * last, high_value.begin());
+                return std::make_pair(low_value, high_value);
+            }
+
+            // r += c * B^(ik) for a non-negative coefficient c
+            void add_coefficient(digit_t *r, std::size_t i, signed_digits const &c) const {
+                std::size_t size = c.size();
+                while (size > 0 && c[size - 1] == 0) size--;
+                add(r + i * k, r + i * k, 2 * n - i * k, c.data(), size);
+            }
+        };
+
+        // Toom-3 with the points 0, 1, -1, 2, infinity
+        void toom3(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n) {
+            toom_split split(n, 3);
+
+            signed_digits v1, vm1, v2, c0, c4;
+            run_parallel(n, {
+                    [&] { v1 = split.product_at(a, b, 1); },
+                    [&] { vm1 = split.product_at(a, b, -1); },
+                    [&] { v2 = split.product_at(a, b, 2); },
+                    [&] { std::tie(c0, c4) = split.products_at_ends(r, a, b); }
+            });
+
+            signed_digits even = shifted_right(v1 + vm1, 1);            // c0 + c2 + c4
+            signed_digits odd = v1 - even;                              // c1 + c3
+            signed_digits c2 = even - c0 - c4;
+            signed_digits t = shifted_right(submul(submul(v2 - c0, c2, 4), c4, 16), 1);  // c1 + 4 c3
+            signed_digits c3 = divexact(t - odd, 3);
+            signed_digits c1 = odd - c3;
+
+            split.add_coefficient(r, 1, c1);
+            split.add_coefficient(r, 2, c2);
+            split.add_coefficient(r, 3, c3);
+        }
+
+        // Toom-4 with the points 0, 1, -1, 2, -2, 1/2, infinity
+        void toom4(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n) {
+            toom_split split(n, 4);
+
+            signed_digits v1, vm1, v2, vm2, vh, c0, c6;
+            run_parallel(n, {
+                    [&] { v1 = split.product_at(a, b, 1); },
+                    [&] { vm1 = split.product_at(a, b, -1); },
+                    [&] { v2 = split.product_at(a, b, 2); },
+                    [&] { vm2 = split.product_at(a, b, -2); },
+                    [&] { vh = split.product_at(a, b, 2, true); },      // 64 f(1/2)
+                    [&] { std::tie(c0, c6) = split.products_at_ends(r, a, b); }
+            });
+
+            signed_digits even1 = shifted_right(v1 + vm1, 1);           // c0 + c2 + c4 + c6
+            signed_digits odd1 = v1 - even1;                            // c1 + c3 + c5
+            signed_digits even2 = shifted_right(v2 + vm2, 1);           // c0 + 4 c2 + 16 c4 + 64 c6
+            signed_digits odd2 = shifted_right(v2 - even2, 1);          // c1 + 4 c3 + 16 c5
+
+            signed_digits e1 = even1 - c0 - c6;                         // c2 + c4
+            signed_digits e2 = shifted_right(submul(even2 - c0, c6, 64), 2);  // c2 + 4 c4
+            signed_digits c4 = divexact(e2 - e1, 3);
+            signed_digits c2 = e1 - c4;
+
+            // 16 c1 + 4 c3 + c5
+            signed_digits h = shifted_right(submul(submul(submul(vh, c0, 64), c2, 16), c4, 4) - c6, 1);
+            signed_digits t1 = divexact(odd2 - odd1, 3);                // c3 + 5 c5
+            signed_digits t2 = divexact(h - odd1, 3);                   // 5 c1 + c3
+            signed_digits c3 = divexact(times(odd1, 5) - t1 - t2, 3);
+            signed_digits c5 = divexact(t1 - c3, 5);
+            signed_digits c1 = divexact(t2 - c3, 5);
+
+            split.add_coefficient(r, 1, c1);
+            split.add_coefficient(r, 2, c2);
+            split.add_coefficient(r, 3, c3);
+            split.add_coefficient(r, 4, c4);
+            split.add_coefficient(r, 5, c5);
+        }
+
+        void mul_balanced(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n) {
+            if (n < karatsuba_threshold) {
+                mul_n(r, a, b, n, nullptr);
+            } else if (n >= ntt_threshold && ntt_fits(n, n)) {
+                mul_ntt(r, a, n, b, n);
+            } else if (n < toom3_threshold) {
+                std::vector<digit_t> scratch(karatsuba_scratch_size(n));
+                karatsuba(r, a, b, n, scratch.data());
+            } else if (n < toom4_threshold) {
+                toom3(r, a, b, n);
+            } else {
+                toom4(r, a, b, n);
+            }
+        }
+    }
+
+    void mul(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        if (an < bn) {
+            std::swap(a, b);
+            std::swap(an, bn);
+        }
+        if (a == b && an == bn && bn < karatsuba_threshold) {
+            sqr_basecase(r, a, an);
+            return;
+        }
+        if (bn < karatsuba_threshold) {
+            mul_basecase(r, a, an, b, bn);
+            return;
+        }
+        if (bn >= ntt_threshold && ntt_fits(an, bn)) {
+            mul_ntt(r, a, an, b, bn);
+            return;
+        }
+
+        // Karatsuba scratch space is shared by all the chunks
+        std::vector<digit_t> scratch(bn < toom3_threshold ? karatsuba_scratch_size(bn) : 0);
+        auto mul_chunk = [&](digit_t *res, const digit_t *x) {
+            if (bn < toom3_threshold) {
+                mul_n(res, x, b, bn, scratch.data());
+            } else {
+                mul_balanced(res, x, b, bn);
+            }
+        };
+
+        mul_chunk(r, a);
+        if (an == bn) return;
+
+        // unbalanced operands: multiply b by bn-digit chunks of a
+        std::fill(r + 2 * bn, r + an + bn, 0);
+        std::vector<digit_t> chunk(2 * bn);
+        for (std::size_t i = bn; i < an; i += bn) {
+            std::size_t len = std::min(bn, an - i);
+            if (len == bn) {
+                mul_chunk(chunk.data(), a + i);
+            } else {
+                mul(chunk.data(), b, bn, a + i, len);
+            }
+            add(r + i, r + i, an + bn - i, chunk.data(), bn + len);
+        }
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef BIGINTEGER_DIGIT_KERNELS_H
+#define BIGINTEGER_DIGIT_KERNELS_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "digit_vector.h"
+
+// Low-level routines working on raw little-endian digit arrays.
+// Output arrays may coincide with the inputs unless stated otherwise.
+namespace digit_kernels {
+    typedef digit_vector::digit_t digit_t;
+    typedef digit_vector::double_digit_t double_digit_t;
+
+    // r[0..n) = a[0..n) + b[0..n), returns the carry
+    digit_t add_n(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n);
+
+    // r[0..n) = a[0..n) - b[0..n), returns the borrow
+    digit_t sub_n(digit_t *r, const digit_t *a, const digit_t *b, std::size_t n);
+
+    // r[0..n) = a[0..n) + c, returns the carry
+    digit_t add_1(digit_t *r, const digit_t *a, std::size_t n, digit_t c);
+
+    // r[0..n) = a[0..n) - c, returns the borrow
+    digit_t sub_1(digit_t *r, const digit_t *a, std::size_t n, digit_t c);
+
+    // r[0..an) = a[0..an) + b[0..bn), an >= bn, returns the carry
+    digit_t add(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+
+    // r[0..an) = a[0..an) - b[0..bn), an >= bn, returns the borrow
+    digit_t sub(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+
+    // r[0..n) = a[0..an) mod (B^n - 1), the result may be B^n - 1 in place of zero.
+    // r must not overlap a
+    void fold(digit_t *r, const digit_t *a, std::size_t an, std::size_t n);
+
+    // r[0..n) = a[0..n) << s, 0 < s < DIGIT_BASE, returns the bits shifted out
+    digit_t lshift(digit_t *r, const digit_t *a, std::size_t n, unsigned s);
+
+    // r[0..n) = a[0..n) >> s, 0 < s < DIGIT_BASE, returns the bits shifted out in the high end of a digit
+    digit_t rshift(digit_t *r, const digit_t *a, std::size_t n, unsigned s);
+
+    // r[0..n) = a[0..n) * b, returns the highest digit of the product
+    digit_t mul_1(digit_t *r, const digit_t *a, std::size_t n, digit_t b);
+
+    // r[0..n) += a[0..n) * b, returns the carry out of r[n - 1]
+    digit_t addmul_1(digit_t *r, const digit_t *a, std::size_t n, digit_t b);
+
+    // r[0..n) -= a[0..n) * b, returns the borrow out of r[n - 1]
+    digit_t submul_1(digit_t *r, const digit_t *a, std::size_t n, digit_t b);
+
+    // r[0..n) = a[0..n) / d for d dividing a exactly. For odd d this is a * d^-1 mod B^n,
+    // so it also divides two's complement negative values
+    void divexact_1(digit_t *r, const digit_t *a, std::size_t n, digit_t d);
+
+    // q[0..n) = a[0..n) / d, returns the remainder. Multiplies by the reciprocal of d instead of
+    // dividing, powers of two are shifted
+    digit_t divrem_1(digit_t *q, const digit_t *a, std::size_t n, digit_t d);
+
+    // floor((B^2 - 1) / d) - B for a digit d with the top bit set, which turns division by d
+    // into multiplications
+    digit_t reciprocal_1(digit_t d);
+
+    // q[0..an - bn + 1) = a / b and, unless r is null, r[0..bn) = a % b for an >= bn >= 1 and
+    // a non-zero highest digit of b. q and r must not overlap the inputs. Knuth's algorithm D
+    // for small operands, Burnikel-Ziegler recursive division for large ones and
+    // a Newton reciprocal for huge ones
+    void divrem(digit_t *q, digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+
+    // A divisor prepared for repeated division: its digits shifted left until the highest one has
+    // the top bit set and, if requested, the reciprocal used by Newton division
+    struct divisor {
+        std::vector<digit_t> digits;
+        unsigned shift;
+        digit_t inverse;    // reciprocal_1 of the highest digit
+        std::vector<digit_t> reciprocal;
+
+        // b[0..bn) with a non-zero highest digit
+        divisor(const digit_t *b, std::size_t bn, bool with_reciprocal);
+    };
+
+    // divrem by a prepared divisor of n = d.digits.size() digits, an >= n. Divisors with
+    // a reciprocal always use Newton division
+    void divrem(digit_t *q, digit_t *r, const digit_t *a, std::size_t an, divisor const &d);
+
+    // r[0..an + bn) = a[0..an) * b[0..bn), an >= bn >= 1, r must not overlap the inputs
+    void mul_basecase(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+
+    // r[0..2n) = a[0..n)^2, n >= 1, r must not overlap a
+    void sqr_basecase(digit_t *r, const digit_t *a, std::size_t n);
+
+    // r[0..an + bn) = a[0..an) * b[0..bn), picks the algorithm by the operand sizes,
+    // r must not overlap the inputs. Equal operands (a == b, an == bn) are squared
+    void mul(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+
+    // r[0..2n) = a[0..n)^2, r must not overlap a
+    void sqr(digit_t *r, const digit_t *a, std::size_t n);
+
+    // r[0..an + bn) = a[0..an) * b[0..bn) by number-theoretic transforms, requires ntt_fits(an, bn),
+    // r must not overlap the inputs
+    void mul_ntt(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+
+    // whether the product of an- and bn-digit operands is within the transform length limit
+    bool ntt_fits(std::size_t an, std::size_t bn);
+
+    // r[0..n) = a[0..an) * b[0..bn) mod (B^n - 1) by a single cyclic transform, which is half as long
+    // as the one of the full product. n must be a power of two with ntt_wraparound_fits(n).
+    // The result may be B^n - 1 in place of zero, r must not overlap the inputs
+    void mul_wraparound(digit_t *r, std::size_t n, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+
+    bool ntt_wraparound_fits(std::size_t n);
+
+    // Balanced operands of at least this many digits are multiplied with the corresponding algorithm.
+    // Karatsuba needs at least 2 digits, Toom-3 at least 12 and Toom-4 at least 16
+    extern std::size_t karatsuba_threshold;
+    extern std::size_t toom3_threshold;
+    extern std::size_t toom4_threshold;
+    extern std::size_t ntt_threshold;
+
+    // Divisions with a divisor and a quotient of at least this many digits (must be >= 4)
+    // use the recursive Burnikel-Ziegler algorithm
+    extern std::size_t bz_threshold;
+
+    // Divisions with a divisor and a quotient of at least this many digits multiply by
+    // a reciprocal computed with Newton's iteration instead
+    extern std::size_t newton_threshold;
+
+    // Divisors prepared for repeated division get a reciprocal from this many digits on, the setup
+    // is paid once so it wins over Burnikel-Ziegler earlier than in a single division
+    extern std::size_t invariant_newton_threshold;
+
+    // Products whose smaller operand has at least this many digits spread their independent
+    // sub-products over a thread pool
+    extern std::size_t parallel_threshold;
+
+    // Number of threads taking part in parallel multiplication including the calling one,
+    // 1 keeps it serial. Defaults to the hardware concurrency, must not be changed while
+    // a multiplication is running
+    void set_thread_count(std::size_t count);
+
+    std::size_t thread_count();
+
+    // Runs the tasks of a product of the given size on the thread pool if it is large enough,
+    // otherwise one after another
+    void run_parallel(std::size_t size, std::vector<std::function<void()>> const &tasks);
+
+    // three-way comparison of a[0..an) and b[0..bn), leading zeros are not allowed
+    int cmp(const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn);
+}
+
+#endif //BIGINTEGER_DIGIT_KERNELS_H
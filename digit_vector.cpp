@@ -1,15 +1,18 @@
 #include "digit_vector.h"
 
-digit_vector::digit_vector() noexcept : small(0), is_small(true), _size(0) {}
+#include <cassert>
+
+const std::size_t digit_vector::INLINE_CAPACITY;
+
+digit_vector::digit_vector() noexcept : small(), is_small(true), _size(0) {}
 
 digit_vector::digit_vector(std::size_t initial_size) : digit_vector() {
-    if (initial_size <= 1) {
-        is_small = true;
-        small = 0;
+    if (initial_size <= INLINE_CAPACITY) {
         _size = initial_size;
     } else {
         is_small = false;
         _size = big.capacity = initial_size;
+        big.borrowed = false;
 
         new(&big.data) std::shared_ptr<digit_t>(new digit_t[_size], std::default_delete<digit_t[]>());
     }
@@ -18,32 +21,47 @@ digit_vector::digit_vector(std::size_t initial_size) : digit_vector() {
 digit_vector::digit_vector(const digit_vector &rhs) {
     if (rhs.is_small) {
         is_small = true;
-        small = rhs.small;
+        std::copy(rhs.small, rhs.small + INLINE_CAPACITY, small);
         _size = rhs._size;
     } else {
         is_small = false;
         _size = rhs._size;
         big.capacity = rhs.big.capacity;
+        big.borrowed = rhs.big.borrowed;
 
         new(&big.data) std::shared_ptr<digit_t>(rhs.big.data);
     }
 }
 
-digit_vector::digit_vector(digit_vector::digit_t *ptr, std::size_t size) {
+digit_vector::digit_vector(digit_vector::digit_t *ptr, std::size_t size) : digit_vector() {
     assert(size > 0);
 
     _size = size;
-    if (size == 1) {
-        is_small = true;
-        small = ptr[0];
+    if (size <= INLINE_CAPACITY) {
+        std::copy(ptr, ptr + size, small);
+        delete[] ptr;
     } else {
         is_small = false;
         big.capacity = size;
+        big.borrowed = false;
 
         new(&big.data) std::shared_ptr<digit_t>(ptr, std::default_delete<digit_t[]>());
     }
 }
 
+digit_vector::digit_vector(std::shared_ptr<const digit_t> const &data, std::size_t size) : digit_vector() {
+    _size = size;
+    if (size <= INLINE_CAPACITY) {
+        std::copy(data.get(), data.get() + size, small);
+        return;
+    }
+
+    is_small = false;
+    big.capacity = size;
+    big.borrowed = true;
+    new(&big.data) std::shared_ptr<digit_t>(std::const_pointer_cast<digit_t>(data));
+}
+
 digit_vector::big_storage::~big_storage() = default;
 
 digit_vector::~digit_vector() {
@@ -59,27 +77,14 @@ bool digit_vector::empty() const {
 }
 
 void digit_vector::clear() {
+    if (!is_small) big.~big_storage();
     is_small = true;
     _size = 0;
-    small = 0;
+    std::fill(small, small + INLINE_CAPACITY, 0);
 }
 
 void digit_vector::increase_capacity() {
-    if (is_small) {
-        digit_t backup = small;
-        new(&big.data) std::shared_ptr<digit_t>(new digit_t[2], std::default_delete<digit_t[]>());
-        big.data.get()[0] = backup;
-        big.capacity = 2;
-        is_small = false;
-    } else {
-        std::size_t new_capacity = 2 * big.capacity;
-
-        auto *clone = new digit_t[new_capacity];
-        std::copy(big.data.get(), big.data.get() + big.capacity, clone);
-
-        new(&big.data) std::shared_ptr<digit_t>(clone, std::default_delete<digit_t[]>());
-        big.capacity = new_capacity;
-    }
+    reserve(is_small ? 2 * INLINE_CAPACITY : 2 * big.capacity);
 }
 
 void digit_vector::decrease_capacity() {
@@ -88,9 +93,8 @@ void digit_vector::decrease_capacity() {
 void digit_vector::push_back(const digit_vector::digit_t &item) {
     prepare_mutation();
 
-    if (_size == 0) {
-        is_small = true;
-        small = item;
+    if (is_small && _size < INLINE_CAPACITY) {
+        small[_size] = item;
     } else {
         if (is_small || _size == big.capacity) increase_capacity();
         assert(big.capacity > _size);
@@ -103,16 +107,11 @@ void digit_vector::push_back(const digit_vector::digit_t &item) {
 void digit_vector::pop_back() {
     assert(_size > 0);
 
-    if (_size == 1) {
-        small = 0;
-        _size--;
-    } else {
-        assert(!is_small);
-
-        _size--;
-        if (_size * 2 <= big.capacity) {
-            decrease_capacity();
-        }
+    _size--;
+    if (is_small) {
+        small[_size] = 0;
+    } else if (_size * 2 <= big.capacity) {
+        decrease_capacity();
     }
 }
 
@@ -120,7 +119,7 @@ digit_vector::iterator digit_vector::begin() {
     prepare_mutation();
 
     if (is_small) {
-        return &small;
+        return small;
     } else {
         return big.data.get();
     }
@@ -128,44 +127,38 @@ digit_vector::iterator digit_vector::begin() {
 
 digit_vector::const_iterator digit_vector::begin() const {
     if (is_small) {
-        return &small;
+        return small;
     } else {
         return big.data.get();
     }
 }
 
-digit_vector::iterator digit_vector::end() {
-    prepare_mutation();
+digit_vector::const_iterator digit_vector::cbegin() const {
+    return begin();
+}
 
-    if (is_small) {
-        return (&small) + 1;
-    } else {
-        return big.data.get() + _size;
-    }
+digit_vector::iterator digit_vector::end() {
+    return begin() + _size;
 }
 
 digit_vector::const_iterator digit_vector::end() const {
-    if (is_small) {
-        return (&small) + 1;
-    } else {
-        return big.data.get() + _size;
-    }
+    return begin() + _size;
 }
 
 const digit_vector::digit_t &digit_vector::back() const {
-    if (is_small) return small;
+    if (is_small) return small[_size > 0 ? _size - 1 : 0];
     else return big.data.get()[_size - 1];
 }
 
 const digit_vector::digit_t &digit_vector::front() const {
-    if (is_small) return small;
+    if (is_small) return small[0];
     else return big.data.get()[0];
 }
 
 const digit_vector::digit_t &digit_vector::operator[](std::size_t idx) const {
     if (is_small) {
-        assert(idx == 0);
-        return small;
+        assert(idx < INLINE_CAPACITY);
+        return small[idx];
     } else {
         assert(idx < _size);
         return big.data.get()[idx];
@@ -174,8 +167,8 @@ const digit_vector::digit_t &digit_vector::operator[](std::size_t idx) const {
 
 digit_vector::digit_t &digit_vector::operator[](std::size_t idx) {
     if (is_small) {
-        assert(idx == 0);
-        return small;
+        assert(idx < INLINE_CAPACITY);
+        return small[idx];
     } else {
         assert(idx < _size);
         prepare_mutation();
@@ -186,10 +179,27 @@ digit_vector::digit_t &digit_vector::operator[](std::size_t idx) {
 void digit_vector::resize(std::size_t new_size) {
     if (new_size <= _size) return;
 
-//    if (is_small) increase_capacity();
-//    assert(!is_small);
+    prepare_mutation();
+    reserve(new_size);
+    digit_t *data = (is_small ? small : big.data.get());
+    std::fill(data + _size, data + new_size, 0);
+    _size = new_size;
+}
 
-    while (_size < new_size) push_back(0);
+void digit_vector::reserve(std::size_t new_capacity) {
+    if (new_capacity <= (is_small ? INLINE_CAPACITY : big.capacity)) return;
+
+    auto *clone = new digit_t[new_capacity];
+    if (is_small) {
+        std::copy(small, small + _size, clone);
+        new(&big.data) std::shared_ptr<digit_t>(clone, std::default_delete<digit_t[]>());
+        is_small = false;
+    } else {
+        std::copy(big.data.get(), big.data.get() + _size, clone);
+        big.data.reset(clone, std::default_delete<digit_t[]>());
+    }
+    big.capacity = new_capacity;
+    big.borrowed = false;
 }
 
 bool digit_vector::operator==(const digit_vector &rhs) const {
@@ -203,33 +213,34 @@ bool digit_vector::operator==(const digit_vector &rhs) const {
 
 void digit_vector::prepare_mutation() {
     if (is_small) return;
-    if (big.data.unique()) return;
+    if (big.data.unique() && !big.borrowed) return;
 
     auto *clone = new digit_t[big.capacity];
-    std::copy(big.data.get(), big.data.get() + big.capacity, clone);
+    std::copy(big.data.get(), big.data.get() + _size, clone);
 
-    new(&big.data) std::shared_ptr<digit_t>(clone);
+    big.data.reset(clone, std::default_delete<digit_t[]>());
+    big.borrowed = false;
 }
 
 template<typename Iterator>
-digit_vector::digit_vector(Iterator first, Iterator last) {
+digit_vector::digit_vector(Iterator first, Iterator last) : digit_vector() {
     for (; first != last; first++) {
         push_back(*first);
     }
 }
 
 digit_vector &digit_vector::operator=(const digit_vector &rhs) {
-    if (*this == rhs) return *this;
+    if (this == &rhs) return *this;
 
     clear();
     if (rhs.is_small) {
-        is_small = true;
-        small = rhs.small;
+        std::copy(rhs.small, rhs.small + INLINE_CAPACITY, small);
         _size = rhs._size;
     } else {
         is_small = false;
         _size = rhs._size;
         big.capacity = rhs.big.capacity;
+        big.borrowed = rhs.big.borrowed;
 
         new(&big.data) std::shared_ptr<digit_t>(rhs.big.data);
     }
@@ -238,37 +249,64 @@ digit_vector &digit_vector::operator=(const digit_vector &rhs) {
 
 void digit_vector::erase(digit_vector::const_iterator pos) {
     std::size_t idx = pos - begin();
-    prepare_mutation();
-
-    if (is_small) {
-        assert(idx == 0);
-        pop_back();
-    } else {
-        assert(idx < _size);
+    assert(idx < _size);
 
-        for (auto i = idx; i < _size - 1; i++) {
-            big.data.get()[i] = big.data.get()[i + 1];
-        }
-        _size--;
-    }
+    digit_t *data = begin();
+    std::copy(data + idx + 1, data + _size, data + idx);
+    pop_back();
 }
 
 void digit_vector::insert(digit_vector::const_iterator pos, const digit_vector::digit_t &value) {
     std::size_t idx = pos - begin();
+    assert(idx <= _size);
 
-    if (_size == 0) {
-        assert(is_small);
-        assert(idx == 0);
-        small = value;
-    } else {
-        if (is_small || big.capacity == _size) increase_capacity();
+    if (_size == (is_small ? INLINE_CAPACITY : big.capacity)) increase_capacity();
+    digit_t *data = begin();
+    std::copy_backward(data + idx, data + _size, data + _size + 1);
+    data[idx] = value;
+    _size++;
+}
+
+void digit_vector::prepend_zeros(std::size_t cnt) {
+    if (cnt == 0) return;
 
-        for (auto i = _size; i > idx; i--) {
-            big.data.get()[i] = big.data.get()[i - 1];
+    std::size_t new_size = _size + cnt;
+    if (is_small ? new_size <= INLINE_CAPACITY : big.data.unique() && !big.borrowed && new_size <= big.capacity) {
+        digit_t *data = (is_small ? small : big.data.get());
+        std::copy_backward(data, data + _size, data + new_size);
+        std::fill(data, data + cnt, 0);
+    } else {
+        auto *clone = new digit_t[new_size];
+        std::fill(clone, clone + cnt, 0);
+        std::copy(cbegin(), cbegin() + _size, clone + cnt);
+        if (is_small) {
+            new(&big.data) std::shared_ptr<digit_t>(clone, std::default_delete<digit_t[]>());
+            is_small = false;
+        } else {
+            big.data.reset(clone, std::default_delete<digit_t[]>());
         }
-        _size++;
-        big.data.get()[idx] = value;
+        big.capacity = new_size;
+        big.borrowed = false;
+    }
+    _size = new_size;
+}
+
+void digit_vector::drop_front(std::size_t cnt) {
+    if (cnt == 0) return;
+    if (cnt >= _size) {
+        clear();
+        return;
+    }
+
+    if (is_small) {
+        std::copy(small + cnt, small + _size, small);
+        std::fill(small + _size - cnt, small + _size, 0);
+    } else {
+        // the aliasing constructor keeps the whole array alive while pointing past the dropped digits
+        big.data = std::shared_ptr<digit_t>(big.data, big.data.get() + cnt);
+        big.capacity -= cnt;
     }
+    _size -= cnt;
 }
 
 digit_vector::reverse_const_iterator digit_vector::rbegin() const {
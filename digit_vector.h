@@ -7,11 +7,21 @@
 #include <memory>
 #include <limits>
 
+#if defined(BIGINT_64BIT_DIGITS) && !defined(__SIZEOF_INT128__)
+#error "64-bit digits require a compiler with unsigned __int128 support"
+#endif
+
 struct digit_vector {
 public:
+#ifdef BIGINT_64BIT_DIGITS
+    typedef uint64_t digit_t;
+    __extension__ typedef unsigned __int128 double_digit_t;
+    static const int DIGIT_BASE = 64;
+#else
     typedef uint32_t digit_t;
     typedef uint64_t double_digit_t;
     static const int DIGIT_BASE = 32;
+#endif
     static const digit_t DIGIT_MASK = std::numeric_limits<digit_t>::max();
 
     digit_vector() noexcept;
@@ -20,6 +30,10 @@ public:
 
     digit_vector(digit_t *ptr, std::size_t size);
 
+    // size digits in storage owned elsewhere and kept alive by data, such as a mapped file. They
+    // are only read, the first change copies them
+    digit_vector(std::shared_ptr<const digit_t> const &data, std::size_t size);
+
     digit_vector(const digit_vector &rhs);
 
     void push_back(const digit_t &item);
@@ -38,6 +52,8 @@ public:
 
     void resize(std::size_t new_size);
 
+    void reserve(std::size_t new_capacity);
+
     bool operator==(const digit_vector &rhs) const;
 
     digit_t &operator[](std::size_t idx);
@@ -56,6 +72,8 @@ public:
 
     const_iterator begin() const;
 
+    const_iterator cbegin() const;
+
     reverse_const_iterator rbegin() const;
 
     iterator end();
@@ -68,6 +86,12 @@ public:
 
     void erase(const_iterator pos);
 
+    // inserts cnt zero digits in front of the first one with a single move of the digits
+    void prepend_zeros(std::size_t cnt);
+
+    // removes the first cnt digits in O(1), the storage keeps them until it is reallocated
+    void drop_front(std::size_t cnt);
+
     template<typename Iterator>
     digit_vector(Iterator first, Iterator last);
 
@@ -77,12 +101,25 @@ private:
     struct big_storage {
         std::size_t capacity;
         std::shared_ptr<digit_t> data;
+        // data is read-only and copied before any change, even when unique
+        bool borrowed;
 
         ~big_storage();
     };
 
+public:
+    // Digits kept in the object itself without allocating, by default as many as fit in the
+    // space of the heap storage: four 64-bit or eight 32-bit digits
+#ifdef BIGINT_INLINE_DIGITS
+    static const std::size_t INLINE_CAPACITY = BIGINT_INLINE_DIGITS;
+#else
+    static const std::size_t INLINE_CAPACITY = sizeof(big_storage) / sizeof(digit_t);
+#endif
+    static_assert(INLINE_CAPACITY >= 1, "at least one digit must be stored inline");
+
+private:
     union {
-        digit_t small;
+        digit_t small[INLINE_CAPACITY];
         big_storage big;
     };
 
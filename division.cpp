@@ -0,0 +1,302 @@
+#include "digit_kernels.h"
+
+#include <algorithm>
+#include <vector>
+
+// Division of normalized operands: the highest digit of the divisor has its top bit set.
+// The remainder is left in the low digits of the dividend.
+namespace digit_kernels {
+    namespace {
+        // Division of u1 B + u0 by a normalized digit d with u1 < d and v = reciprocal_1(d),
+        // algorithm 4 of Moller and Granlund "Improved division by invariant integers"
+        inline digit_t divrem_2by1(digit_t &r, digit_t u1, digit_t u0, digit_t d, digit_t v) {
+            double_digit_t p = (double_digit_t) v * u1 + (((double_digit_t) u1 << digit_vector::DIGIT_BASE) | u0);
+            digit_t q1 = (digit_t) (p >> digit_vector::DIGIT_BASE) + 1, q0 = (digit_t) p;
+            r = u0 - q1 * d;
+
+            // the first adjustment is taken about half of the time, so it is done without a branch
+            digit_t mask = 0 - (digit_t) (r > q0);
+            q1 += mask;
+            r += mask & d;
+            if (r >= d) {
+                q1++;
+                r -= d;
+            }
+            return q1;
+        }
+
+        // divrem_1 by the normalized digit d = divisor << shift with v = reciprocal_1(d)
+        digit_t divrem_1_preinv(digit_t *q, const digit_t *a, std::size_t n, digit_t d, unsigned shift, digit_t v) {
+            if (n == 0) return 0;
+            if (shift == 0) {
+                digit_t rem = 0;
+                for (std::size_t i = n; i > 0; i--) q[i - 1] = divrem_2by1(rem, rem, a[i - 1], d, v);
+                return rem;
+            }
+
+            // the digits of a << shift are formed on the fly, the extra highest one is below d
+            digit_t rem = a[n - 1] >> (digit_vector::DIGIT_BASE - shift);
+            for (std::size_t i = n; i > 1; i--) {
+                digit_t digit = (a[i - 1] << shift) | (a[i - 2] >> (digit_vector::DIGIT_BASE - shift));
+                q[i - 1] = divrem_2by1(rem, rem, digit, d, v);
+            }
+            q[0] = divrem_2by1(rem, rem, a[0] << shift, d, v);
+            return rem >> shift;
+        }
+
+        // Knuth's algorithm D. q[0..m) = u[0..n + m) / v[0..n), u[0..n) becomes the remainder.
+        // Requires u < 2 B^m v, returns the extra highest quotient digit which is 0 or 1
+        digit_t divrem_basecase(digit_t *q, digit_t *u, std::size_t m, const digit_t *v, std::size_t n) {
+            digit_t q_high = 0;
+            if (cmp(u + m, n, v, n) >= 0) {
+                sub_n(u + m, u + m, v, n);
+                q_high = 1;
+            }
+
+            const digit_t v1 = v[n - 1], v2 = (n >= 2 ? v[n - 2] : 0), inverse = reciprocal_1(v1);
+            for (std::size_t j = m; j > 0; j--) {
+                digit_t *window = u + j - 1;
+
+                // estimate the quotient digit from the top three digits of the window, it is
+                // either exact or one too large afterwards. The top digit never exceeds v1
+                digit_t digit, r_hat;
+                bool r_hat_overflow = false;
+                if (window[n] == v1) {
+                    digit = ~digit_t(0);
+                    r_hat = window[n - 1] + v1;
+                    r_hat_overflow = r_hat < v1;
+                } else {
+                    digit = divrem_2by1(r_hat, window[n], window[n - 1], v1, inverse);
+                }
+                digit_t third = (n >= 2 ? window[n - 2] : 0);
+                while (!r_hat_overflow &&
+                       (double_digit_t) digit * v2 > (((double_digit_t) r_hat << digit_vector::DIGIT_BASE) | third)) {
+                    digit--;
+                    r_hat += v1;
+                    r_hat_overflow = r_hat < v1;
+                }
+
+                digit_t borrow = submul_1(window, v, n, digit);
+                digit_t highest = window[n];
+                window[n] = highest - borrow;
+                if (highest < borrow) {
+                    digit--;
+                    window[n] += add_n(window, window, v, n);
+                }
+                q[j - 1] = digit;
+            }
+            return q_high;
+        }
+
+        // u[0..n) -= t[0..tn) for tn <= n + 1, then adds v back while the result is negative,
+        // decrementing the quotient digits q[0..qn) and their extra highest digit every time
+        void subtract_and_correct(digit_t *u, std::size_t n, std::vector<digit_t> const &t,
+                                  const digit_t *v, digit_t *q, std::size_t qn, digit_t &q_high) {
+            std::size_t tn = t.size();
+            digit_t borrow = (tn <= n ? sub(u, u, n, t.data(), tn) : sub_n(u, u, t.data(), n) + t[n]);
+            while (borrow > 0) {
+                q_high -= sub_1(q, q, qn, 1);
+                borrow -= add_n(u, u, v, n);
+            }
+        }
+
+        // Recursive division (Burnikel-Ziegler, in the form of Brent and Zimmermann's RecursiveDivRem):
+        // q[0..m) = u[0..n + m) / v[0..n) for m <= n, with the same contract as divrem_basecase
+        digit_t divrem_recursive(digit_t *q, digit_t *u, std::size_t m, const digit_t *v, std::size_t n) {
+            if (m < bz_threshold) return divrem_basecase(q, u, m, v, n);
+
+            std::size_t k = m / 2;
+
+            // the high half of the quotient from the top digits of u and v
+            digit_t q_high = divrem_recursive(q + k, u + 2 * k, m - k, v + k, n - k);
+            std::vector<digit_t> t(m + 1);
+            mul(t.data(), q + k, m - k, v, k);
+            t[m] = (q_high ? add(t.data() + m - k, t.data() + m - k, k, v, k) : 0);
+            subtract_and_correct(u + k, n, t, v, q + k, m - k, q_high);
+
+            // the low half from the partial remainder
+            digit_t q_low_high = divrem_recursive(q, u + k, k, v + k, n - k);
+            t.assign(2 * k + 1, 0);
+            mul(t.data(), q, k, v, k);
+            t[2 * k] = (q_low_high ? add(t.data() + k, t.data() + k, k, v, k) : 0);
+            q_high += add_1(q + k, q + k, m - k, q_low_high);
+            subtract_and_correct(u, n, t, v, q, m, q_high);
+
+            return q_high;
+        }
+
+        // r[0..k) = c[0..cn) - a[0..an) * b[0..bn) for a difference known to lie in [0, B^k), with
+        // cn >= k, an + bn >= k and an >= bn. Only the low digits of the product matter, so a large one
+        // is computed modulo B^n - 1 for the power of two n > k, which is up to twice as cheap
+        void product_deficit(digit_t *r, std::size_t k, const digit_t *c, std::size_t cn,
+                             const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+            std::size_t n = 1;
+            while (n <= k) n <<= 1;
+
+            if (bn >= ntt_threshold && n < an + bn && ntt_wraparound_fits(n)) {
+                std::vector<digit_t> product(n), difference(n);
+                mul_wraparound(product.data(), n, a, an, b, bn);
+                fold(difference.data(), c, cn, n);
+                if (sub_n(difference.data(), difference.data(), product.data(), n)) {
+                    sub_1(difference.data(), difference.data(), n, 1);
+                }
+                // the high digits are only set in the all-ones form of zero
+                if (difference[n - 1] != 0) {
+                    std::fill(r, r + k, 0);
+                } else {
+                    std::copy(difference.begin(), difference.begin() + k, r);
+                }
+            } else {
+                std::vector<digit_t> product(an + bn);
+                mul(product.data(), a, an, b, bn);
+                sub_n(r, c, product.data(), k);
+            }
+        }
+
+        // x[0..n + 1) = floor(B^2n / v[0..n)) - d for some d in {0, 1, 2} by Newton's iteration on
+        // the reciprocal of the top half of v
+        void invert(digit_t *x, const digit_t *v, std::size_t n) {
+            if (n < std::max<std::size_t>(newton_threshold, 4)) {
+                std::vector<digit_t> power(2 * n + 1), q(n + 2);
+                power[2 * n] = 1;
+                divrem(q.data(), nullptr, power.data(), 2 * n + 1, v, n);
+                std::copy(q.begin(), q.begin() + n + 1, x);
+                return;
+            }
+
+            // y is at most floor(B^2h / v_high) - 5, which is below B^2h / (v_high + 1), so x0 = y B^(n - h)
+            // is an underestimate of B^2n / v with an error below 8 B^(n - h)
+            std::size_t h = n / 2 + 1;
+            std::vector<digit_t> y(h + 1);
+            invert(y.data(), v + n - h, h);
+            sub_1(y.data(), y.data(), h + 1, 5);
+
+            // e = (B^2n - v x0) / B^(n - h) = B^(n + h) - v y, which is below 8 B^n
+            std::vector<digit_t> power(n + h + 1), e(n + 1);
+            power[n + h] = 1;
+            product_deficit(e.data(), n + 1, power.data(), n + h + 1, v, n, y.data(), h + 1);
+
+            // x = x0 + x0 e / B^2n stays below B^2n / v and misses it by less than 3, the low h - 1
+            // digits of e are too small to matter
+            std::size_t en = n - h + 2;
+            std::vector<digit_t> step(n + 3);
+            if (en >= h + 1) {
+                mul(step.data(), e.data() + h - 1, en, y.data(), h + 1);
+            } else {
+                mul(step.data(), y.data(), h + 1, e.data() + h - 1, en);
+            }
+            std::fill(x, x + n - h, 0);
+            std::copy(y.begin(), y.end(), x + n - h);
+            add(x, x, n + 1, step.data() + h + 1, n - h + 1);
+        }
+
+        // Division by a multiplication with the reciprocal x from invert, the same contract as
+        // divrem_recursive with u < B^m v
+        void divrem_reciprocal(digit_t *q, digit_t *u, std::size_t m, const digit_t *v, std::size_t n,
+                               const digit_t *x) {
+            // the quotient estimate from the top m + 1 digits of u is at most 4 too small
+            std::vector<digit_t> t(n + m + 2);
+            mul(t.data(), x, n + 1, u + n - 1, m + 1);
+            std::copy(t.begin() + n + 1, t.begin() + n + m + 1, q);
+
+            // the remainder is below 5 v, so only its low n + 1 digits are computed
+            product_deficit(t.data(), n + 1, u, n + m, v, n, q, m);
+            std::copy(t.begin(), t.begin() + n + 1, u);
+            std::fill(u + n + 1, u + n + m, 0);
+            while (u[n] != 0 || cmp(u, n, v, n) >= 0) {
+                u[n] -= sub_n(u, u, v, n);
+                add_1(q, q, m, 1);
+            }
+        }
+    }
+
+    digit_t reciprocal_1(digit_t d) {
+        return (digit_t) ((((double_digit_t) ~d << digit_vector::DIGIT_BASE) | ~digit_t(0)) / d);
+    }
+
+    digit_t divrem_1(digit_t *q, const digit_t *a, std::size_t n, digit_t d) {
+        if (n == 0) return 0;
+        unsigned shift = 0;
+        while (((d << shift) >> (digit_vector::DIGIT_BASE - 1)) == 0) shift++;
+
+        // powers of two only need a shift
+        if ((d & (d - 1)) == 0) {
+            unsigned bits = digit_vector::DIGIT_BASE - 1 - shift;
+            if (bits == 0) {
+                if (q != a) std::copy(a, a + n, q);
+                return 0;
+            }
+            digit_t rem = a[0] & (d - 1);
+            rshift(q, a, n, bits);
+            return rem;
+        }
+
+        digit_t normalized = d << shift;
+        return divrem_1_preinv(q, a, n, normalized, shift, reciprocal_1(normalized));
+    }
+
+    divisor::divisor(const digit_t *b, std::size_t bn, bool with_reciprocal) : digits(b, b + bn), shift(0) {
+        // normalize so that the highest digit has its top bit set
+        while (((b[bn - 1] << shift) >> (digit_vector::DIGIT_BASE - 1)) == 0) shift++;
+        if (shift > 0) lshift(digits.data(), digits.data(), bn, shift);
+        inverse = reciprocal_1(digits[bn - 1]);
+
+        if (with_reciprocal) {
+            reciprocal.resize(bn + 1);
+            invert(reciprocal.data(), digits.data(), bn);
+        }
+    }
+
+    void divrem(digit_t *q, digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        if (bn == 1) {
+            digit_t rem = divrem_1(q, a, an, b[0]);
+            if (r != nullptr) r[0] = rem;
+            return;
+        }
+
+        std::size_t qn = an - bn + 1;
+        divrem(q, r, a, an, divisor(b, bn, bn >= newton_threshold && qn >= newton_threshold));
+    }
+
+    void divrem(digit_t *q, digit_t *r, const digit_t *a, std::size_t an, divisor const &d) {
+        const digit_t *v = d.digits.data();
+        std::size_t bn = d.digits.size();
+        if (bn == 1) {
+            digit_t rem = divrem_1_preinv(q, a, an, v[0], d.shift, d.inverse);
+            if (r != nullptr) r[0] = rem;
+            return;
+        }
+
+        std::vector<digit_t> u(an + 1);
+        if (d.shift > 0) {
+            u[an] = lshift(u.data(), a, an, d.shift);
+        } else {
+            std::copy(a, a + an, u.begin());
+            u[an] = 0;
+        }
+
+        // the quotient is produced in blocks of at most bn digits from the top,
+        // the remainder of every block is the top of the next one
+        std::size_t qn = an - bn + 1;
+        std::size_t block = (qn % bn == 0 ? bn : qn % bn);
+        if (!d.reciprocal.empty()) {
+            for (std::size_t pos = qn; pos > 0; pos -= block, block = bn) {
+                divrem_reciprocal(q + pos - block, u.data() + pos - block, block, v, bn, d.reciprocal.data());
+            }
+        } else if (bn < bz_threshold || qn < bz_threshold) {
+            divrem_basecase(q, u.data(), qn, v, bn);
+        } else {
+            for (std::size_t pos = qn; pos > 0; pos -= block, block = bn) {
+                divrem_recursive(q + pos - block, u.data() + pos - block, block, v, bn);
+            }
+        }
+
+        if (r != nullptr) {
+            if (d.shift > 0) {
+                rshift(r, u.data(), bn, d.shift);
+            } else {
+                std::copy(u.begin(), u.begin() + bn, r);
+            }
+        }
+    }
+}
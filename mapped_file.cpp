@@ -0,0 +1,99 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BIGINT_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace {
+#ifdef BIGINT_MMAP
+    std::shared_ptr<const unsigned char> map_file(std::string const &path, std::size_t &size) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+
+        struct stat info{};
+        if (fstat(fd, &info) != 0) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "cannot read the size of " + path);
+        }
+        size = (std::size_t) info.st_size;
+        if (size == 0) {
+            close(fd);
+            return nullptr;
+        }
+
+        void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        int error = errno;
+        close(fd);
+        if (address == MAP_FAILED) throw std::system_error(error, std::generic_category(), "cannot map " + path);
+
+        // the values are read front to back
+        madvise(address, size, MADV_SEQUENTIAL);
+        std::size_t length = size;
+        return std::shared_ptr<const unsigned char>(static_cast<const unsigned char *>(address),
+                                                    [length](const unsigned char *p) {
+                                                        munmap(const_cast<unsigned char *>(p), length);
+                                                    });
+    }
+#else
+    // without mmap the file is read into memory once, and values borrow from that copy
+    std::shared_ptr<const unsigned char> map_file(std::string const &path, std::size_t &size) {
+        // streams do not report why they failed, errno may be stale
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::system_error(std::make_error_code(std::errc::io_error), "cannot open " + path);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (in.bad()) throw std::system_error(std::make_error_code(std::errc::io_error), "cannot read " + path);
+        size = bytes.size();
+
+        // digit_vector::digit_t storage keeps the digits aligned
+        std::size_t digits = (size + sizeof(digit_vector::digit_t) - 1) / sizeof(digit_vector::digit_t);
+        std::shared_ptr<digit_vector::digit_t> buffer(new digit_vector::digit_t[digits],
+                                                      std::default_delete<digit_vector::digit_t[]>());
+        std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char *>(buffer.get()));
+        return std::shared_ptr<const unsigned char>(buffer, reinterpret_cast<const unsigned char *>(buffer.get()));
+    }
+#endif
+}
+
+mapped_binary_file::mapped_binary_file(std::string const &path) : size(0), position(0) {
+    data = map_file(path, size);
+}
+
+bool mapped_binary_file::at_end() const {
+    return position == size;
+}
+
+const unsigned char *mapped_binary_file::begin() const {
+    return data.get();
+}
+
+const unsigned char *mapped_binary_file::end() const {
+    return data.get() + size;
+}
+
+big_integer mapped_binary_file::read(bool borrow) {
+    const unsigned char *first = data.get() + position;
+    big_integer value;
+    const unsigned char *last = (borrow ? from_binary(first, data.get() + size, value, data) :
+                                 from_binary(first, data.get() + size, value));
+    position = last - data.get();
+    return value;
+}
+
+std::vector<big_integer> mapped_binary_file::read_all(bool borrow) {
+    std::vector<big_integer> values;
+    while (!at_end()) {
+        values.push_back(read(borrow));
+    }
+    return values;
+}
@@ -0,0 +1,35 @@
+#ifndef BIGINTEGER_MAPPED_FILE_H
+#define BIGINTEGER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "big_integer.h"
+
+// A file of values in the binary format, mapped into memory and read front to back. Borrowed
+// values keep their digits in the mapping, which stays alive as long as any of them does
+struct mapped_binary_file {
+    // throws std::system_error if the file cannot be opened or mapped
+    explicit mapped_binary_file(std::string const &path);
+
+    bool at_end() const;
+
+    // the bytes of the file, which borrowed values point into
+    const unsigned char *begin() const;
+
+    const unsigned char *end() const;
+
+    // the next value; borrowed digits are copied on the first change, the others right away
+    big_integer read(bool borrow = true);
+
+    // the values up to the end of the file
+    std::vector<big_integer> read_all(bool borrow = true);
+
+private:
+    std::shared_ptr<const unsigned char> data;
+    std::size_t size;
+    std::size_t position;
+};
+
+#endif // BIGINTEGER_MAPPED_FILE_H
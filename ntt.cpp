@@ -0,0 +1,236 @@
+#include "digit_kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Multiplication by number-theoretic transforms modulo three primes below 2^30.
+// The operands are cut into 32-bit chunks, the cyclic convolution is computed modulo
+// every prime and the coefficients are restored by the Chinese remainder theorem.
+namespace digit_kernels {
+    namespace {
+        const uint64_t CHUNK_MASK = 0xffffffffu;
+        const std::size_t CHUNKS_PER_DIGIT = digit_vector::DIGIT_BASE / 32;
+        const std::size_t MAX_TRANSFORM_SIZE = std::size_t(1) << 23;
+
+        uint32_t pow_mod(uint64_t a, uint64_t e, uint32_t p) {
+            uint64_t res = 1;
+            a %= p;
+            for (; e > 0; e >>= 1) {
+                if (e & 1) res = res * a % p;
+                a = a * a % p;
+            }
+            return (uint32_t) res;
+        }
+
+        // Montgomery arithmetic with R = 2^32. The transformed data stays in the normal domain,
+        // only the twiddle factors are kept in Montgomery form
+        struct ntt_prime {
+            uint32_t p;
+            uint32_t neg_inverse;   // -p^-1 mod 2^32
+            uint32_t r2;            // 2^64 mod p
+            uint32_t generator;
+
+            ntt_prime(uint32_t p, uint32_t generator) : p(p), generator(generator) {
+                uint32_t inverse = p;
+                for (int i = 0; i < 4; i++) inverse *= 2 - p * inverse;
+                neg_inverse = -inverse;
+                r2 = (uint32_t) ((std::numeric_limits<uint64_t>::max() % p + 1) % p);
+            }
+
+            // t * 2^-32 mod p for t < p * 2^32, which also makes to_montgomery valid for any 32-bit value
+            uint32_t reduce(uint64_t t) const {
+                uint32_t m = (uint32_t) t * neg_inverse;
+                auto u = (uint32_t) ((t + (uint64_t) m * p) >> 32);
+                return normalize(u - p);
+            }
+
+            uint32_t mul(uint32_t a, uint32_t b) const {
+                return reduce((uint64_t) a * b);
+            }
+
+            uint32_t to_montgomery(uint32_t a) const {
+                return mul(a, r2);
+            }
+
+            // x + p if x wrapped around below zero, p < 2^30 keeps the sign bit meaningful.
+            // The branchless form matters: the comparisons in the butterflies are unpredictable
+            uint32_t normalize(uint32_t x) const {
+                return x + (p & (0u - (x >> 31)));
+            }
+
+            uint32_t add(uint32_t a, uint32_t b) const {
+                return normalize(a + b - p);
+            }
+
+            uint32_t sub(uint32_t a, uint32_t b) const {
+                return normalize(a - b);
+            }
+
+            void transform(std::vector<uint32_t> &a, bool inverse) const {
+                std::size_t n = a.size();
+                for (std::size_t i = 1, j = 0; i < n; i++) {
+                    std::size_t bit = n >> 1;
+                    for (; j & bit; bit >>= 1) j ^= bit;
+                    j ^= bit;
+                    if (i < j) std::swap(a[i], a[j]);
+                }
+
+                std::vector<uint32_t> twiddles(n / 2);
+                for (std::size_t len = 2; len <= n; len <<= 1) {
+                    std::size_t half = len / 2;
+                    uint32_t root = pow_mod(generator, (p - 1) / len, p);
+                    if (inverse) root = pow_mod(root, p - 2, p);
+
+                    uint32_t step = to_montgomery(root);
+                    twiddles[0] = to_montgomery(1);
+                    for (std::size_t j = 1; j < half; j++) twiddles[j] = mul(twiddles[j - 1], step);
+
+                    for (std::size_t i = 0; i < n; i += len) {
+                        for (std::size_t j = 0; j < half; j++) {
+                            uint32_t u = a[i + j];
+                            uint32_t v = mul(a[i + j + half], twiddles[j]);
+                            a[i + j] = add(u, v);
+                            a[i + j + half] = sub(u, v);
+                        }
+                    }
+                }
+            }
+
+            // Cyclic convolution of the chunk arrays modulo p, both of the transform size,
+            // b is not used for squaring. The chunks enter in Montgomery form, the pointwise products leave it again
+            std::vector<uint32_t> convolution(std::vector<uint32_t> fa, std::vector<uint32_t> const &b, bool square) const {
+                for (uint32_t &x : fa) x = to_montgomery(x);
+                transform(fa, false);
+                if (square) {
+                    for (uint32_t &x : fa) x = mul(x, x);
+                } else {
+                    std::vector<uint32_t> fb = b;
+                    for (uint32_t &x : fb) x = to_montgomery(x);
+                    transform(fb, false);
+                    for (std::size_t i = 0; i < fa.size(); i++) fa[i] = mul(fa[i], fb[i]);
+                }
+                transform(fa, true);
+
+                // the inverse transform gained a factor of n, multiplying by a plain n^-1
+                // also takes the values out of Montgomery form
+                uint32_t scale = pow_mod(fa.size(), p - 2, p);
+                for (uint32_t &x : fa) x = mul(x, scale);
+                return fa;
+            }
+        };
+
+        const ntt_prime PRIMES[] = {ntt_prime(469762049, 3), ntt_prime(167772161, 3), ntt_prime(998244353, 3)};
+
+        std::vector<uint32_t> to_chunks(const digit_t *a, std::size_t n, std::size_t size) {
+            std::vector<uint32_t> res(size, 0);
+            for (std::size_t i = 0; i < n; i++) {
+                for (std::size_t j = 0; j < CHUNKS_PER_DIGIT; j++) {
+                    res[i * CHUNKS_PER_DIGIT + j] = (uint32_t) ((double_digit_t) a[i] >> (32 * j));
+                }
+            }
+            return res;
+        }
+
+        std::size_t transform_size(std::size_t an, std::size_t bn) {
+            std::size_t size = 1;
+            while (size < (an + bn) * CHUNKS_PER_DIGIT) size <<= 1;
+            return size;
+        }
+    }
+
+    namespace {
+        // Convolves the chunk arrays modulo every prime and restores the coefficients, propagating
+        // their carries through r[0..n). Returns the carry out of r[n - 1] in digits
+        std::vector<digit_t> convolve_and_carry(digit_t *r, std::size_t n, std::vector<uint32_t> const &fa,
+                                                std::vector<uint32_t> const &fb, bool square, std::size_t size) {
+            std::vector<uint32_t> r1, r2, r3;
+            run_parallel(size, {
+                    [&] { r1 = PRIMES[0].convolution(fa, fb, square); },
+                    [&] { r2 = PRIMES[1].convolution(fa, fb, square); },
+                    [&] { r3 = PRIMES[2].convolution(fa, fb, square); }
+            });
+
+            // Garner's algorithm: x = x1 + p1 x2 + p1 p2 x3
+            const ntt_prime &q1 = PRIMES[0], &q2 = PRIMES[1], &q3 = PRIMES[2];
+            const uint64_t p1 = q1.p, p2 = q2.p, p3 = q3.p;
+            const uint32_t one_mod_p2 = q2.to_montgomery(1);
+            const uint32_t p1_inverse_mod_p2 = q2.to_montgomery(pow_mod(p1, p2 - 2, p2));
+            const uint32_t p1_mod_p3 = q3.to_montgomery((uint32_t) (p1 % p3));
+            const uint32_t p1p2_inverse_mod_p3 = q3.to_montgomery(pow_mod(p1 * p2 % p3, p3 - 2, p3));
+            const uint64_t p1p2 = p1 * p2;
+
+            uint64_t acc[3] = {0, 0, 0};
+            for (std::size_t i = 0; i < n; i++) {
+                double_digit_t digit = 0;
+                for (std::size_t j = 0; j < CHUNKS_PER_DIGIT; j++) {
+                    std::size_t idx = i * CHUNKS_PER_DIGIT + j;
+                    uint32_t x1 = r1[idx];
+                    uint32_t x2 = q2.mul(q2.sub(r2[idx], q2.mul(x1, one_mod_p2)), p1_inverse_mod_p2);
+                    uint32_t x3 = q3.mul(q3.sub(q3.sub(r3[idx], x1), q3.mul(x2, p1_mod_p3)), p1p2_inverse_mod_p3);
+
+                    uint64_t low = x1 + p1 * x2;
+                    uint64_t mid = (p1p2 & CHUNK_MASK) * x3;
+                    uint64_t high = (p1p2 >> 32) * x3;
+
+                    uint64_t w0 = (low & CHUNK_MASK) + (mid & CHUNK_MASK) + acc[0];
+                    uint64_t w1 = (low >> 32) + (mid >> 32) + (high & CHUNK_MASK) + acc[1] + (w0 >> 32);
+                    uint64_t w2 = (high >> 32) + acc[2] + (w1 >> 32);
+
+                    digit |= (double_digit_t) (w0 & CHUNK_MASK) << (32 * j);
+                    acc[0] = w1 & CHUNK_MASK;
+                    acc[1] = w2 & CHUNK_MASK;
+                    acc[2] = w2 >> 32;
+                }
+                r[i] = (digit_t) digit;
+            }
+
+            std::vector<digit_t> carry;
+            for (std::size_t i = 0; i < 3; i += CHUNKS_PER_DIGIT) {
+                double_digit_t digit = 0;
+                for (std::size_t j = 0; j < CHUNKS_PER_DIGIT && i + j < 3; j++) {
+                    digit |= (double_digit_t) acc[i + j] << (32 * j);
+                }
+                carry.push_back((digit_t) digit);
+            }
+            return carry;
+        }
+    }
+
+    bool ntt_fits(std::size_t an, std::size_t bn) {
+        return transform_size(an, bn) <= MAX_TRANSFORM_SIZE;
+    }
+
+    void mul_ntt(digit_t *r, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        std::size_t size = transform_size(an, bn);
+        bool square = (a == b && an == bn);
+        std::vector<uint32_t> fa = to_chunks(a, an, size);
+        std::vector<uint32_t> fb = (square ? std::vector<uint32_t>() : to_chunks(b, bn, size));
+
+        convolve_and_carry(r, an + bn, fa, fb, square, std::min(an, bn));
+    }
+
+    bool ntt_wraparound_fits(std::size_t n) {
+        // every coefficient of a cyclic convolution sums up to size chunk products, which stays
+        // below p1 p2 p3 only for half of the longest transform
+        return n * CHUNKS_PER_DIGIT <= MAX_TRANSFORM_SIZE / 2;
+    }
+
+    void mul_wraparound(digit_t *r, std::size_t n, const digit_t *a, std::size_t an, const digit_t *b, std::size_t bn) {
+        std::size_t size = n * CHUNKS_PER_DIGIT;
+        bool square = (a == b && an == bn);
+        std::vector<digit_t> folded(n);
+        fold(folded.data(), a, an, n);
+        std::vector<uint32_t> fa = to_chunks(folded.data(), n, size);
+        std::vector<uint32_t> fb;
+        if (!square) {
+            fold(folded.data(), b, bn, n);
+            fb = to_chunks(folded.data(), n, size);
+        }
+
+        std::vector<digit_t> carry = convolve_and_carry(r, n, fa, fb, square, n);
+        digit_t wrapped = add(r, r, n, carry.data(), carry.size());
+        while (wrapped > 0) wrapped = add_1(r, r, n, wrapped);
+    }
+}
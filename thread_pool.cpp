@@ -0,0 +1,111 @@
+#include "thread_pool.h"
+
+namespace {
+    thread_local const void *current_pool = nullptr;
+    thread_local std::size_t current_queue = 0;
+}
+
+thread_pool::thread_pool(std::size_t threads) : queued(0), stopping(false) {
+    for (std::size_t i = 0; i <= threads; i++) {
+        queues.emplace_back(new task_queue());
+    }
+    for (std::size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&thread_pool::worker_loop, this, i);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake_up.notify_all();
+    for (std::thread &worker : workers) worker.join();
+}
+
+std::size_t thread_pool::size() const {
+    return workers.size();
+}
+
+std::size_t thread_pool::home_queue() const {
+    return current_pool == this ? current_queue : workers.size();
+}
+
+void thread_pool::execute(task const &t) {
+    try {
+        (*t.function)();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(t.owner->mutex);
+        if (!t.owner->error) t.owner->error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(t.owner->mutex);
+    if (--t.owner->pending == 0) t.owner->finished.notify_all();
+}
+
+bool thread_pool::run_one(std::size_t home) {
+    for (std::size_t step = 0; step < queues.size(); step++) {
+        task_queue &queue = *queues[(home + step) % queues.size()];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        task t;
+        if (step == 0) {
+            t = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            t = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        lock.unlock();
+
+        queued--;
+        execute(t);
+        return true;
+    }
+    return false;
+}
+
+void thread_pool::run(std::vector<std::function<void()>> const &tasks) {
+    if (tasks.empty()) return;
+
+    batch current;
+    current.pending = tasks.size();
+
+    // counted before they become visible, so that the counter never drops below zero
+    queued += tasks.size() - 1;
+    std::size_t home = home_queue();
+    {
+        std::lock_guard<std::mutex> lock(queues[home]->mutex);
+        for (std::size_t i = 1; i < tasks.size(); i++) {
+            queues[home]->tasks.push_back(task{&tasks[i], &current});
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake_up.notify_all();
+
+    execute(task{&tasks[0], &current});
+    // helps while there are queued tasks, then sleeps until the stolen ones are finished
+    while (current.pending > 0 && run_one(home)) {}
+    {
+        std::unique_lock<std::mutex> lock(current.mutex);
+        current.finished.wait(lock, [&current] { return current.pending == 0; });
+    }
+
+    if (current.error) std::rethrow_exception(current.error);
+}
+
+void thread_pool::worker_loop(std::size_t idx) {
+    current_pool = this;
+    current_queue = idx;
+
+    while (true) {
+        if (run_one(idx)) continue;
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake_up.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping) return;
+    }
+}
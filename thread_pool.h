@@ -0,0 +1,71 @@
+#ifndef BIGINTEGER_THREAD_POOL_H
+#define BIGINTEGER_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool with a task deque per thread. Threads take their own tasks
+// from the back and steal from the front of the other deques.
+struct thread_pool {
+public:
+    explicit thread_pool(std::size_t threads);
+
+    thread_pool(const thread_pool &) = delete;
+
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    ~thread_pool();
+
+    std::size_t size() const;
+
+    // Runs the tasks and returns when all of them are finished, rethrowing the first exception.
+    // The calling thread executes tasks while it waits, so tasks may call run() themselves.
+    void run(std::vector<std::function<void()>> const &tasks);
+
+private:
+    // pending only drops under the mutex, so the caller cannot leave run() while the thread
+    // finishing the last task still uses the batch
+    struct batch {
+        std::atomic<std::size_t> pending;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    struct task {
+        std::function<void()> const *function;
+        batch *owner;
+    };
+
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    // one queue per worker and a shared one for the threads outside the pool
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<std::size_t> queued;
+    std::mutex sleep_mutex;
+    std::condition_variable wake_up;
+    bool stopping;
+
+    std::size_t home_queue() const;
+
+    bool run_one(std::size_t home);
+
+    static void execute(task const &t);
+
+    void worker_loop(std::size_t idx);
+};
+
+#endif //BIGINTEGER_THREAD_POOL_H